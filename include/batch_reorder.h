@@ -0,0 +1,11 @@
+#pragma once
+
+#include "types.h"
+#include "dynamic_tree.h"
+
+
+// Queries are only answered between batches and updates to different edges commute, so a batch
+// can be reordered as long as the updates to each edge keep their order. Moves every deletion of a
+// forest edge, and every later update to the same edge, behind the rest of updates[0, num_updates).
+// Both parts keep their order. Returns the number of updates left in front
+uint32_t reorder_batch(GraphUpdate* updates, uint32_t num_updates, DynamicTree& forest);
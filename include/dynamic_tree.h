@@ -0,0 +1,20 @@
+#pragma once
+
+// The dynamic forest used as the cycle and max tier oracle by GraphTiers and InputNode.
+// A backend must provide:
+//   Backend(node_id_t num_nodes);
+//   void link(node_id_t v, node_id_t w, uint32_t weight);
+//   void cut(node_id_t v, node_id_t w);
+//   bool has_edge(node_id_t v, node_id_t w);
+//   uint32_t get_edge_weight(node_id_t v, node_id_t w);
+//   PathMaxResult connected_path_max(node_id_t v, node_id_t w);
+//   std::vector<PathMaxResult> connected_path_max(const std::vector<std::pair<node_id_t, node_id_t>>& queries);
+// Select the backend at configure time with -DDYNAMIC_TREE=LCT (default) or -DDYNAMIC_TREE=RC_TREE
+
+#ifdef DYNAMIC_TREE_RC_TREE
+#include "rc_tree.h"
+typedef RCTree DynamicTree;
+#else
+#include "link_cut_tree.h"
+typedef LinkCutTree DynamicTree;
+#endif
@@ -6,6 +6,7 @@
 
 
 class EulerTourNode {
+  friend class EulerTourTree;
   FRIEND_TEST(EulerTourTreeSuite, random_links_and_cuts);
   FRIEND_TEST(EulerTourTreeSuite, get_aggregate);
   FRIEND_TEST(SkipListSuite, join_split_test);
@@ -13,30 +14,40 @@ class EulerTourNode {
   
   std::unordered_map<EulerTourNode*, SkipListNode*> edges;
 
-  Sketch* temp_sketch = nullptr;
   long seed = 0;
+  const GraphConfig* config = nullptr;
+  const std::vector<long>* shared_seeds = nullptr;
 
-  SkipListNode* make_edge(EulerTourNode* other, Sketch* temp_sketch);
-  void delete_edge(EulerTourNode* other, Sketch* temp_sketch);
+  // temp holds the aggregates of a vertex between deleting its last skiplist node and making a new one
+  SkipListNode* make_edge(EulerTourNode* other, SkipListNode* temp);
+  void delete_edge(EulerTourNode* other, SkipListNode* temp);
 
 public:
   const node_id_t vertex = 0;
   const uint32_t tier = 0;
   SkipListNode* allowed_caller = nullptr;
 
-  EulerTourNode(long seed, node_id_t vertex, uint32_t tier);
+  EulerTourNode(long seed, node_id_t vertex, uint32_t tier, const GraphConfig* config,
+      const std::vector<long>* shared_seeds = nullptr);
   EulerTourNode(long seed);
   ~EulerTourNode();
-  bool link(EulerTourNode& other, Sketch* temp_sketch);
-  bool cut(EulerTourNode& other, Sketch* temp_sketch);
+  bool link(EulerTourNode& other, SkipListNode* temp);
+  bool cut(EulerTourNode& other, SkipListNode* temp);
 
   bool isvalid() const;
 
+  // Build the sentinel skiplist for this vertex if it has not been used yet
+  void touch();
+  // Untouched vertices are singletons with no skiplist and an empty sketch
+  bool is_touched() const;
+
   Sketch* get_sketch(SkipListNode* caller);
   SkipListNode* update_sketch(vec_t update_idx);
 
+  // Returns nullptr for an untouched vertex, callers that use the root must only ask for touched ones
   SkipListNode* get_root();
 
+  // Returns nullptr for an untouched vertex
   Sketch* get_aggregate();
   uint32_t get_size();
   bool has_edge_to(EulerTourNode* other);
@@ -44,22 +55,55 @@ public:
   std::set<EulerTourNode*> get_component();
 
   long get_seed() {return seed;};
+  const GraphConfig* get_config() {return config;};
+  const std::vector<long>* get_shared_seeds() {return shared_seeds;};
 
   friend std::ostream& operator<<(std::ostream& os, const EulerTourNode& ett);
 };
 
+typedef struct {
+  SkipListNode* root1 = nullptr;
+  SkipListNode* root2 = nullptr;
+  // Both endpoints share a root so the update cancelled below it and the
+  // root aggregate, size, and isolation status are unchanged
+  bool root_unchanged = false;
+} SketchUpdateResult;
+
 class EulerTourTree {
-  Sketch* temp_sketch;
+  const GraphConfig config;  // every node and skiplist node of this tree points here
+  // Seeds of the other tiers whose forest is this one, each keeps its own aggregates in the skiplists
+  std::vector<long> shared_seeds;
+  SkipListNode* temp_aggs;
+  // The bottom node of every skiplist column of the tree, including the boundary columns
+  std::vector<SkipListNode*> get_columns();
 public:
   std::vector<EulerTourNode> ett_nodes;
   
-  EulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed);
+  EulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed, const GraphConfig& config = default_graph_config());
+  ~EulerTourTree();
+  EulerTourTree(const EulerTourTree&) = delete;
+  EulerTourTree& operator=(const EulerTourTree&) = delete;
 
   void link(node_id_t u, node_id_t v);
   void cut(node_id_t u, node_id_t v);
   bool has_edge(node_id_t u, node_id_t v);
   SkipListNode* update_sketch(node_id_t u, vec_t update_idx);
-  std::pair<SkipListNode*, SkipListNode*> update_sketches(node_id_t u, node_id_t v, vec_t update_idx);
+  SketchUpdateResult update_sketches(node_id_t u, node_id_t v, vec_t update_idx);
+  // Add a whole sketch to the vertex u and the aggregates above it
+  void merge_sketch(node_id_t u, Sketch* sketch);
+  // Returns the sketch of just the vertex u, or nullptr if u was never touched
+  Sketch* get_vertex_sketch(node_id_t u);
+  // Add a tier sharing this forest, its aggregates start empty
+  void add_shared_tier(long seed);
+  // Stop sharing the forest with the shared tiers from shared_tier on
+  void remove_shared_tiers(uint32_t shared_tier);
+  uint32_t num_shared_tiers() const { return shared_seeds.size(); }
+  // Same as merge_sketch and get_vertex_sketch for one of the shared tiers
+  void merge_shared_sketch(uint32_t shared_tier, node_id_t u, Sketch* sketch);
+  Sketch* get_shared_vertex_sketch(uint32_t shared_tier, node_id_t u);
+  // Returns every edge of the forest once as (smaller, larger) endpoint pairs
+  std::vector<std::pair<node_id_t, node_id_t>> get_edges();
+  // Returns nullptr if u was never touched, like get_vertex_sketch
   SkipListNode* get_root(node_id_t u);
   Sketch* get_aggregate(node_id_t u);
   uint32_t get_size(node_id_t u);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "types.h"
+
+
+// Parameters of the structures for one graph. Every Euler tour tree and
+// skiplist node reads these through its owner instead of process globals,
+// so graphs of different sizes can live in the same process.
+typedef struct {
+  double height_factor;             // skiplist height multiplier for the tier ETTs
+  vec_t sketch_len;
+  vec_t sketch_err;
+  long skiplist_seed;               // seed of the skiplist height hash
+  double sketchless_height_factor;  // skiplist height multiplier for the query ETT
+  long sketchless_skiplist_seed;
+} GraphConfig;
+
+// Snapshot of the process wide defaults (height_factor, sketch_len, ...)
+// for callers that still configure through the globals
+GraphConfig default_graph_config();
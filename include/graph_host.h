@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "graph_tiers.h"
+#include "tier_thread_pool.h"
+
+
+// Hosts many independent graphs in one process. Each graph runs all of its
+// tiers on the thread that owns it, and the graphs are spread over one shared
+// pool of workers so many small graphs can keep every core busy.
+class GraphHost {
+  uint32_t max_graphs;
+  uint32_t batch_size;
+  std::vector<std::unique_ptr<GraphTiers>> graphs;
+  std::vector<std::vector<GraphUpdate>> pending;  // buffered updates of each graph
+  TierThreadPool pool;  // declared after graphs so workers stop before the graphs are destroyed
+
+  void flush_graph(uint32_t graph_id);
+public:
+  // num_threads of 0 sizes the shared pool from OMP_NUM_THREADS
+  GraphHost(uint32_t max_graphs, uint32_t batch_size = 100, uint32_t num_threads = 0);
+
+  // add a graph with its own parameters and return its id
+  uint32_t add_graph(node_id_t num_nodes, const GraphConfig& config, bool collapse_tiers = false);
+
+  // buffer an edge update, once any graph has a full batch every graph is flushed
+  void update(uint32_t graph_id, GraphUpdate update);
+  // apply the buffered updates of every graph, each on the worker that owns it
+  void flush();
+
+  // queries apply the graph's buffered updates first
+  std::vector<std::set<node_id_t>> get_cc(uint32_t graph_id);
+  bool is_connected(uint32_t graph_id, node_id_t a, node_id_t b);
+
+  uint32_t num_graphs() { return graphs.size(); }
+  GraphTiers& get_graph(uint32_t graph_id) { return *graphs[graph_id]; }
+};
@@ -3,45 +3,102 @@
 #include "types.h"
 #include <vector>
 #include <atomic>
+#include <memory>
 
+#include "graph_config.h"
 #include "euler_tour_tree.h"
-#include "link_cut_tree.h"
-
-
-// Global variables for performance testing
-extern long lct_time;
-extern long ett_time;
-extern long ett_find_root;
-extern long ett_get_agg;
-extern long sketch_query;
-extern long sketch_time;
-extern long refresh_time;
-extern long parallel_isolated_check;
-extern long tiers_grown;
-extern long normal_refreshes;
-extern std::atomic<long> num_sketch_updates;
-extern std::atomic<long> num_sketch_batches;
+#include "dynamic_tree.h"
+#include "tier_thread_pool.h"
+
+
+// Counters for performance testing, kept per graph
+typedef struct {
+  long lct_time = 0;
+  long ett_time = 0;
+  long ett_find_root = 0;
+  long ett_get_agg = 0;
+  long sketch_query = 0;
+  long sketch_time = 0;
+  long refresh_time = 0;
+  long parallel_isolated_check = 0;
+  long tiers_grown = 0;
+  long normal_refreshes = 0;
+  long tiers_collapsed = 0;
+  long tiers_materialized = 0;
+  long updates_without_refresh = 0;
+  std::atomic<long> isolated_check_skipped{0};
+  std::atomic<long> sketch_samples_skipped{0};
+} GraphTiersMetrics;
 
 // maintains the tiers of the algorithm
 // and the spanning forest of the entire graph
 class GraphTiers {
   FRIEND_TEST(GraphTiersSuite, mini_correctness_test);
 private:
-  std::vector<EulerTourTree> ett;  // one ETT for each tier
-  std::vector<SkipListNode*> root_nodes;
-  LinkCutTree link_cut_tree;
+  // state written by the worker that owns a tier, padded so tiers do not share cache lines
+  struct alignas(64) TierState {
+    std::pair<SkipListNode*, SkipListNode*> roots;  // roots of the endpoint trees after an update
+    bool root_unchanged;  // the last update cancelled below a shared root
+    // buffers for the greedy batch check
+    std::vector<std::pair<uint32_t, uint32_t>> batch_sizes;
+    std::vector<SampleResult> batch_query_results;
+    std::vector<bool> batch_split_revert;
+    uint32_t isolated_update;
+  };
+
+  const GraphConfig config;
+  GraphTiersMetrics metrics;
+  node_id_t num_nodes;
+  std::vector<std::unique_ptr<EulerTourTree>> ett;  // one ETT for each tier, null if collapsed
+  std::vector<int> tier_seeds;
+  std::vector<TierState> tier_state;
+  DynamicTree dynamic_tree;
+  std::vector<uint32_t> dt_split_revert;
+
+  // Tier collapsing: a run of tiers with identical forests shares the ETT of its lowest tier,
+  // the representative, and the other tiers in the run keep their aggregates as shared tiers of it
+  bool collapse_tiers;
+  std::vector<uint32_t> rep;  // representative tier of each tier
+  std::vector<uint32_t> weight_counts;  // number of forest edges first appearing on each tier
+  node_id_t updates_since_collapse = 0;
+
+  TierThreadPool pool;  // declared after ett so workers stop before the tiers are destroyed
   void refresh(GraphUpdate update);
+  // Speculatively apply updates [first_update, last_update) and keep them up to the first one
+  // that isolates a tree on any tier, which is returned, or last_update if none does
+  uint32_t greedy_check(const std::vector<GraphUpdate>& updates, uint32_t first_update, uint32_t last_update);
+  // update_batch checks a batch greedily in ranges of this length, about twice the updates between isolations
+  uint32_t greedy_window = MAX_INT;
+
+  // dynamic tree operations that keep weight_counts up to date
+  void dt_link(node_id_t a, node_id_t b, uint32_t weight);
+  void dt_cut(node_id_t a, node_id_t b);
+  // the aggregate of a tier, collapsed or not, in the tree with root in its representative's ETT
+  Sketch* tier_aggregate(uint32_t tier, SkipListNode* root);
+  // sample the tree containing v on a tier, collapsed or not
+  SketchSample sample_tier(uint32_t tier, node_id_t v);
+  // give a collapsed tier its own ETT before its forest diverges from the tier below
+  void materialize_tier(uint32_t tier);
+  // collapse every materialized tier whose forest equals the forest of the tier below
+  void collapse_identical_tiers();
+  void count_updates(uint32_t num_updates);
 
 public:
-  GraphTiers(node_id_t num_nodes);
-  ~GraphTiers();
+  // num_threads of 0 sizes the tier thread pool from OMP_NUM_THREADS
+  // collapse_tiers lets tiers with identical forests share one ETT
+  GraphTiers(node_id_t num_nodes, uint32_t num_threads = 0, bool collapse_tiers = false,
+      const GraphConfig& config = default_graph_config());
 
   // apply an edge update
   void update(GraphUpdate update);
+  // apply a batch of edge updates by greedily speculating that none of them cause isolation
+  void update_batch(const std::vector<GraphUpdate>& updates);
 
   // query for the connected components of the graph
   std::vector<std::set<node_id_t>> get_cc();
 
   // query for if a is connected to b
   bool is_connected(node_id_t a, node_id_t b);
+
+  const GraphTiersMetrics& get_metrics() const { return metrics; }
 };
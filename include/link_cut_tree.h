@@ -6,6 +6,13 @@
 #include "util.h"
 
 #define MAX_UINT64 (std::numeric_limits<uint64_t>::max())
+
+typedef struct {
+  bool connected = false;
+  edge_id_t max_edge = 0;
+  uint32_t weight = 0;
+} PathMaxResult;
+
 class LinkCutTree;
 class SplayTree;
 
@@ -17,22 +24,25 @@ class LinkCutNode {
   LinkCutNode* left;
   LinkCutNode* right;
   
+  //First and last nodes on the path in this subtree, kept up to date by rebuild_max
   LinkCutNode* head = this;
   LinkCutNode* tail = this;
 
-  //Keep a list of edges with weights and up to two preferred edges
+  //Keep up to two preferred edges with their weights inline so aggregates never touch the edge table
   std::pair<edge_id_t, edge_id_t> preferred_edges = {MAX_UINT64, MAX_UINT64};
-  std::unordered_map<edge_id_t, uint32_t> edges = {};
+  std::pair<uint32_t, uint32_t> preferred_weights = {0, 0};
   //Maintain an aggregate maximum of the edge weights in the auxilliary tree
   uint32_t max = 0;
   edge_id_t max_edge = MAX_UINT64;
-  //Recompute the maximum just for this single node
+  //Recompute the maximum, head and tail just for this single node
   void rebuild_max();
 
-  //Indicates that the meanings of left and right are reversed at all nodes in this subtree
-  bool reversed;
-  //Reverses all of appropriate nodes on the path from the root to this node
-  void correct_reversals();
+  //Indicates that left and right of this node and all nodes below it still need to be swapped
+  bool reversed = false;
+  //Swap this node's children and pass the reversal on to them
+  void push_down();
+  //Push all pending reversals down the path from the aux root to this node
+  void push_path();
 
   void rotate_up();
 
@@ -45,15 +55,14 @@ class LinkCutNode {
     void set_parent(LinkCutNode* parent);
     void set_dparent(LinkCutNode* dparent);
     
-    void make_preferred_edge(edge_id_t e);
+    void make_preferred_edge(edge_id_t e, uint32_t weight);
     void unmake_preferred_edge(edge_id_t e);
-    void insert_edge(edge_id_t e, uint32_t weight);
+    // Stop counting a deleted edge's weight if it is still one of the preferred edges
     void remove_edge(edge_id_t e);
-    bool has_edge(edge_id_t e);
-    uint32_t get_edge_weight(edge_id_t e);
     void set_max(uint32_t weight);
 
     void set_reversed(bool reversed);
+    //Reverse the path order of this subtree lazily
     void reverse();
     void set_use_edge_up(bool use_edge_up);
     void set_use_edge_down(bool use_edge_down);
@@ -65,8 +74,6 @@ class LinkCutNode {
 
     LinkCutNode* get_head();
     LinkCutNode* get_tail();
-    LinkCutNode* recompute_head();
-    LinkCutNode* recompute_tail();
     std::pair<edge_id_t, uint32_t> get_max_edge();
     bool get_reversed();
 };
@@ -75,8 +82,11 @@ class LinkCutTree {
   FRIEND_TEST(LinkCutTreeSuite, join_split_test);
   FRIEND_TEST(LinkCutTreeSuite, expose_simple_test);
   FRIEND_TEST(LinkCutTreeSuite, random_links_and_cuts);
+  FRIEND_TEST(LinkCutTreeSuite, connected_path_max_test);
   
   std::vector<LinkCutNode> nodes;
+  // Weight of every edge in the represented forest, stored once for both endpoints
+  std::unordered_map<edge_id_t, uint32_t> edge_weights;
 
   // Concatenate the paths with aux trees rooted at v and w and return the root of the combined aux tree
   LinkCutNode* join(LinkCutNode* v, LinkCutNode* w);
@@ -100,6 +110,10 @@ class LinkCutTree {
 
     // Given node v and w return the edge with the maximum weight on the path from v to w and the weight itself
     std::pair<edge_id_t, uint32_t> path_aggregate(node_id_t v, node_id_t w);
+    // Check if v and w are connected and if so also return the maximum weight edge on their path
+    PathMaxResult connected_path_max(node_id_t v, node_id_t w);
+    // Answer many connected_path_max queries, everting each distinct first endpoint only once
+    std::vector<PathMaxResult> connected_path_max(const std::vector<std::pair<node_id_t, node_id_t>>& queries);
     bool has_edge(node_id_t v1, node_id_t v2);
     uint32_t get_edge_weight(node_id_t v1, node_id_t v2);
 
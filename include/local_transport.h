@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+
+#include "transport.h"
+
+
+struct LocalContext;
+struct LocalOperation;
+
+// Transport between the threads of one process, so the nodes run the same protocol at shared memory
+// speed without MPI. Broadcasts go through a lock-free ring of slots that the root fills and every
+// other rank copies out, and collectives meet at a spinning barrier. Point to point messages are
+// queued in a mailbox per rank, so sends never block.
+class LocalTransport : public Transport {
+  std::shared_ptr<LocalContext> context;
+  int local_rank;
+  uint64_t next_bcast = 0;  // sequence number of the next broadcast, the same on every rank
+  uint64_t next_child = 0;  // number of dup and split calls so far
+  std::vector<LocalOperation*> posted_recvs;  // irecvs not completed yet, in the order they were posted
+  std::vector<int> neighbor_sources;
+  std::vector<int> neighbor_destinations;
+  std::shared_ptr<LocalContext> child_context(uint64_t key, int child_size);
+  bool complete(LocalOperation* operation, bool block);
+public:
+  LocalTransport(std::shared_ptr<LocalContext> context, int rank);
+
+  int rank() override { return local_rank; }
+  int size() override;
+  std::unique_ptr<Transport> dup() override;
+  std::unique_ptr<Transport> split(bool member) override;
+  std::unique_ptr<Transport> neighbors(const std::vector<int>& sources, const std::vector<int>& destinations) override;
+
+  void send(const void* message, int size, int dest, int tag) override;
+  void recv(void* message, int size, int source, int tag) override;
+  TransportRequest isend(const void* message, int size, int dest, int tag) override;
+  TransportRequest irecv(void* message, int size, int source, int tag) override;
+  int probe(int source, int tag) override;
+
+  void bcast(void* message, int size, int root) override;
+  TransportRequest ibcast(void* message, int size, int root) override;
+  uint32_t allreduce_min(uint32_t value) override;
+  void reduce_bitwise_or(const uint32_t* send_data, uint32_t* recv_data, int count, int root) override;
+  void barrier() override;
+  TransportRequest ineighbor_alltoall(const void* send_data, void* recv_data, int size) override;
+
+  void wait(TransportRequest& request) override;
+  void waitall(std::vector<TransportRequest>& requests) override;
+  bool test(TransportRequest& request) override;
+};
+
+// Run body on num_ranks threads, each with the transport of its rank, and wait for all of them
+void run_local(int num_ranks, std::function<void(Transport&)> body);
@@ -1,102 +1,225 @@
 #pragma once
 
-#include <mpi.h>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <queue>
+#include <unordered_map>
 
 #include "types.h"
 #include "euler_tour_tree.h"
 #include "sketchless_euler_tour_tree.h"
-#include "link_cut_tree.h"
-#include "mpi_functions.h"
+#include "dynamic_tree.h"
+#include "transport.h"
+#include "mpi_transport.h"
+#include "wire_format.h"
+#include "tier_placement.h"
+#include "batch_reorder.h"
+#include "tier_thread_pool.h"
 
 
-enum TreeOperationType {
-  NOT_ISOLATED=0, ISOLATED=1, EMPTY, LINK, CUT, LCT_QUERY
-};
-
-typedef struct {
-  GraphUpdate update;
-  bool end = false;
-} UpdateMessage;
-
-typedef struct {
-  TreeOperationType type = EMPTY;
-  node_id_t endpoint1 = 0;
-  node_id_t endpoint2 = 0;
-  uint32_t start_tier = 0;
-} EttUpdateMessage;
-
-typedef struct {
-  TreeOperationType type = EMPTY;
-  node_id_t endpoint1 = 0;
-  node_id_t endpoint2 = 0;
-} LctQueryMessage;
-
+// Optional features of the InputNode, the defaults run the plain greedy batch protocol
 typedef struct {
-  bool connected = false;
-  edge_id_t cycle_edge = 0;
-  uint32_t weight = 0;
-} LctResponseMessage;
-
-typedef struct {
-  node_id_t v = 0;
-  uint32_t prev_tier_size = 0;
-  SketchSample sketch_query_result;
-} RefreshEndpoint;
-
-typedef struct {
-  std::pair<RefreshEndpoint, RefreshEndpoint> endpoints;
-} RefreshMessage;
-
-typedef struct {
-  uint32_t size1 = 0;
-  uint32_t size2 = 0;
-} GreedyRefreshMessage;
+  bool concurrent_refresh = false;  // resolve independent isolated updates of a batch together
+  bool reorder_batches = false;     // run the updates that cannot disconnect the forest first
+  // 0 keeps every batch at batch_size, otherwise batch_size is only the starting size
+  // and the tier nodes must be built with max_batch_size
+  int max_batch_size = 0;
+  bool replicated_lct = false;      // every tier node keeps a copy of the forest and answers its own cycle queries
+  bool query_node = false;          // the last rank runs a QueryNode that answers the submitted queries
+} InputNodeOptions;
 
 class InputNode {
   node_id_t num_nodes;
   uint32_t num_tiers;
-  LinkCutTree link_cut_tree;
+  Transport& world;
+  std::unique_ptr<Transport> comm;  // the input node and the tier nodes
+  TierPlacement placement;
+  DynamicTree dynamic_tree;
   SketchlessEulerTourTree query_ett;
-  UpdateMessage* update_buffer;
+  GraphUpdate* update_buffer;  // indexed from 1 like the updates of a batch in the protocol
   int buffer_size;
   int buffer_capacity;
+  // Encoded batches are broadcast on their own transport, the tier nodes post the receive of the next header early
+  std::unique_ptr<Transport> batch_comm;
+  BatchHeader batch_header;
+  uint8_t* batch_payload;
+  TransportRequest batch_requests[2];
+  bool batch_concurrent_refresh = false;
+  // Send the header then the encoded updates of the current batch
+  void broadcast_batch(uint32_t num_updates, uint8_t flags);
   int* split_revert_buffer;
   void process_updates();
+  // Receive the refresh protocol of one isolated update and apply its forest changes
+  void refresh_update(uint32_t update_idx);
+  // Concurrent refresh: isolated updates in different components of the graph are resolved in one round
+  bool concurrent_refresh = false;
+  std::vector<uint32_t> component_labels;
+  std::vector<uint32_t> isolated_bitmap;
+  std::vector<uint32_t> refresh_selection;  // next update to check, number of refreshes, then the updates
+  // Label updates [first_update, num_updates] by the component of the graph their refresh could change
+  void label_components(uint32_t first_update, uint32_t num_updates);
+  // Pick the first isolated update and the later isolated updates that are independent of it
+  void select_refreshes(uint32_t first_update, uint32_t num_updates);
+  void refresh_updates(uint32_t* update_idxs, uint32_t num_refreshes);
+  // The tier nodes answer the cycle queries themselves, this node only follows the refresh steps
+  bool replicated_lct = false;
+  void apply_refresh_step(EttRefreshStepMessage message);
+  // Changes to query_ett, logged for the query node when there is one
+  void cut_query_forest(node_id_t a, node_id_t b);
+  void link_query_forest(node_id_t a, node_id_t b);
+  // Query node: the last rank of the world follows query_ett from the net forest changes of
+  // every batch and answers the submitted queries while this node goes on with the stream
+  bool query_node = false;
+  int query_rank;
+  std::unordered_map<edge_id_t, int> forest_changes;  // links minus cuts of each edge in the current batch
+  std::deque<std::pair<TransportRequest, std::vector<uint8_t>>> query_sends;
+  uint32_t queries_sent = 0;
+  uint32_t answers_received = 0;
+  std::unordered_map<uint32_t, std::vector<node_id_t>> answers;
+  void send_to_query_node(QueryNodeMessage message, const EttUpdateMessage* changes = nullptr);
+  void send_forest_changes();
+  std::vector<node_id_t> receive_answer(uint32_t query);
+  // Move the deletions of forest edges behind the rest of the batch
+  bool reorder_batches = false;
   std::queue<bool> isolation_history_queue;
   int history_size;
   int isolation_count;
   bool using_sliding_window = false;
+  // Adaptive batch size: after every full batch the batch size moves within [1, max_batch_size]
+  // based on how many updates a greedy check commits before an isolated update, how many
+  // refreshes the batch ran and on the throughput of the batch
+  bool adaptive_batches = false;
+  int max_batch_size;
+  double last_throughput = 0;  // updates per microsecond of the last full batch
+  void adapt_batch_size(uint32_t num_updates, uint32_t commit_length, long num_refreshes, long batch_time);
 public:
-  InputNode(node_id_t num_nodes, uint32_t num_tiers, int batch_size, int seed);
+  // world connects this node to the other nodes, rank 0 of it is this node
+  InputNode(node_id_t num_nodes, uint32_t num_tiers, int batch_size, int seed,
+      const GraphConfig& config = default_graph_config(), const InputNodeOptions& options = InputNodeOptions(),
+      Transport& world = mpi_world());
   ~InputNode();
+  int get_batch_size() { return buffer_capacity-1; }
   void update(GraphUpdate update);
   void process_all_updates();
   bool connectivity_query(node_id_t a, node_id_t b);
   std::vector<std::set<node_id_t>> cc_query();
+  // Queries answered by the query node against the graph after the last processed batch. They do
+  // not wait for the updates still buffered and return an id that later collects the answer
+  uint32_t submit_connectivity_query(node_id_t a, node_id_t b);
+  uint32_t submit_cc_query();
+  bool connectivity_answer(uint32_t query);
+  std::vector<std::set<node_id_t>> cc_answer(uint32_t query);
   void end();
 };
 
-class TierNode {
+// Tier nodes exchange the sizes of the greedy check with the tiers around them in chunks of this many updates
+constexpr uint32_t size_message_chunk = 32;
+// Traffic between the input node and the query node, which is outside the transport of the tiers
+constexpr int QUERY_NODE_TAG = 2;
+constexpr int QUERY_ANSWER_TAG = 3;
+
+// State of one of the tiers hosted by a tier node
+struct TierState {
   EulerTourTree ett;
   uint32_t tier_num;
-  uint32_t num_tiers;
-  int batch_size;
-  UpdateMessage* update_buffer;
   GreedyRefreshMessage* this_sizes_buffer;
-  GreedyRefreshMessage* next_sizes_buffer;
+  GreedyRefreshMessage* next_sizes_buffer;  // sizes of the tier above when it is on another rank
   SampleResult* query_result_buffer;
   bool* split_revert_buffer;
+  Sketch* staged_sketch;
+  // Roots of the endpoints of each staged update, only valid during a greedy check
+  std::vector<std::pair<SkipListNode*, SkipListNode*>> staged_roots;
+  bool staged_roots_valid = false;
+  // Microseconds of refreshes this tier spent waiting, on other ranks or on the other hosted tiers
+  long refresh_idle_time = 0;
+  TierState(node_id_t num_nodes, uint32_t tier_num, int batch_size, int seed, const GraphConfig& config);
+  ~TierState();
+};
+
+class TierNode {
+  node_id_t num_nodes;
+  uint32_t num_tiers;
+  std::unique_ptr<Transport> comm;  // the input node and the tier nodes
+  int batch_size;
+  int world_rank;
+  TierPlacement placement;
+  // The contiguous range of tiers hosted by this node, from lowest to highest
+  std::vector<std::unique_ptr<TierState>> tiers;
+  TierThreadPool pool;  // declared after tiers so workers stop before the tiers are destroyed
+  std::unique_ptr<Transport> batch_comm;
+  // The tier ranks as a chain, each one receives sizes from the rank above it and sends to the one below
+  std::unique_ptr<Transport> chain_comm;
+  GraphUpdate* update_buffer;  // indexed from 1 like the updates of a batch in the protocol
+  uint8_t* batch_payload;
+  // Header of the next batch, received while the current batch is processed
+  BatchHeader next_header;
+  TransportRequest header_request;
+  std::vector<TransportRequest> size_requests;
   bool using_sliding_window = false;
-  void update_tier(GraphUpdate update);
-  void ett_update_tier(EttUpdateMessage message);
-  void refresh_tier(RefreshMessage messsage);
+  bool concurrent_refresh = false;
+  std::vector<uint32_t> isolated_bitmap;  // every update isolated on a tier of this node in the last greedy check
+  std::vector<uint32_t> refresh_selection;
+  // Copy of the input node's forest with the max tier of every edge, built when the first batch asks for it.
+  // It follows the speculative cuts of each greedy check and every refresh step
+  std::unique_ptr<DynamicTree> lct_replica;
+  std::vector<uint32_t> lct_revert_buffer;  // tier of each forest edge cut by the greedy check, MAX_INT if none
+  void cut_replica(uint32_t first_update, uint32_t num_updates);
+  void relink_replica(uint32_t first_update, uint32_t num_updates);
+  // Answer the cycle queries of the isolated endpoints, from the replica or from the input node
+  void query_cycles(EttUpdateMessage* update_messages, LctResponseMessage* responses, uint32_t num_queries);
+  bool hosts(uint32_t tier) { return placement.rank_of(tier) == world_rank; }
+  TierState& local_tier(uint32_t tier) { return *tiers[tier - tiers[0]->tier_num]; }
+  void cache_staged_roots(TierState& tier, uint32_t first_staged, uint32_t last_staged);
+  // Aggregate of the tree containing v without the staged updates [first_staged, last_staged]
+  Sketch* get_staged_aggregate(TierState& tier, node_id_t v, uint32_t first_staged, uint32_t last_staged);
+  // Speculatively apply updates [first_update, num_updates] on every hosted tier and return
+  // the first one isolated on any of them
+  int greedy_check(uint32_t first_update, uint32_t num_updates);
+  // Sketch updates and samples of one tier for the greedy check, the lowest hosted tier publishes its sizes
+  void check_tier(TierState& tier, uint32_t first_update, uint32_t num_updates, bool lowest);
+  // Sizes of the lowest hosted tier ready to be sent, published by the thread checking that tier,
+  // and how many of them the calling thread, the only one that may use MPI, has sent
+  std::atomic<uint32_t> sizes_ready;
+  uint32_t sizes_sent;
+  // Exchange every complete chunk of ready sizes, the last chunk of the batch may be short
+  void exchange_ready_sizes(uint32_t num_updates);
+  // Send the sizes of updates [first, last) of the lowest hosted tier to the rank of the tier below
+  // and receive those of the tier above the highest hosted tier. Every tier rank calls it for the same chunks
+  void exchange_sizes(uint32_t first, uint32_t last);
+  // Run the tier by tier refresh protocol for one isolated update
+  void refresh_update(uint32_t update_idx, uint32_t last_staged);
+  // Run one refresh protocol round for isolated updates whose refreshes change disjoint trees
+  void refresh_updates(uint32_t* update_idxs, uint32_t num_refreshes, uint32_t last_staged);
+  // Fill in the size and sample of the tree of each endpoint on a tier for the refresh of the tier above
+  void sample_endpoints(TierState& tier, RefreshMessage& message, uint32_t first_staged, uint32_t last_staged);
+  void apply_refresh_step(EttRefreshStepMessage message);
+  void ett_update_tiers(EttUpdateMessage message);
+  void refresh_tier(TierState& tier, RefreshMessage messsage);
+  void refresh_tier(TierState& tier, RefreshMessage* messages, uint32_t num_refreshes);
 public:
-  TierNode(node_id_t num_nodes, uint32_t tier_num, uint32_t num_tiers, int batch_size, int seed);
+  // Hosts the tiers that the placement over the ranks of world other than the query node gives this
+  // rank. Tier i of the node gets seed+i and the greedy work of the tiers is split over num_threads
+  // threads, 0 uses omp_get_max_threads(). batch_size is the largest batch the input node sends
+  TierNode(node_id_t num_nodes, uint32_t num_tiers, int batch_size, int seed,
+      const GraphConfig& config = default_graph_config(), uint32_t num_threads = 0,
+      Transport& world = mpi_world());
   ~TierNode();
   void main();
 };
 
+// Optional last rank of the world. It keeps a copy of the input node's query forest from the
+// forest changes sent after every batch and answers the submitted queries in the order they came
+class QueryNode {
+  Transport& world;
+  SketchlessEulerTourTree query_ett;
+  void apply_forest_changes(const EttUpdateMessage* changes, uint32_t num_changes);
+public:
+  QueryNode(node_id_t num_nodes, int seed, const GraphConfig& config = default_graph_config(),
+      Transport& world = mpi_world());
+  void main();
+};
+
 // #define CANARY(X) do {if (true) {int canary_h; MPI_Comm_rank(MPI_COMM_WORLD, &canary_h); std::cout << __FILE__ << ":" << __LINE__ << " @ " << canary_h << " says " << X << std::endl;}} while (false)
 #define CANARY(X) ;
 // #define ENDPOINT_CANARY(X, src, dst) do {if (true) {int canary_h; MPI_Comm_rank(MPI_COMM_WORLD, &canary_h); std::cout << __FILE__ << ":" << __LINE__ << " @ Tier " << canary_h-1 << " says " << X << " " << src << " " << dst << std::endl;}} while (false)
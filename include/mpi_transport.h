@@ -0,0 +1,41 @@
+#pragma once
+
+#include <mpi.h>
+
+#include "transport.h"
+
+
+class MPITransport : public Transport {
+  MPI_Comm comm;
+  bool owns_comm;
+public:
+  // The communicator is freed with the transport only if it owns it
+  MPITransport(MPI_Comm comm, bool owns_comm = false);
+  ~MPITransport();
+
+  int rank() override;
+  int size() override;
+  std::unique_ptr<Transport> dup() override;
+  std::unique_ptr<Transport> split(bool member) override;
+  std::unique_ptr<Transport> neighbors(const std::vector<int>& sources, const std::vector<int>& destinations) override;
+
+  void send(const void* message, int size, int dest, int tag) override;
+  void recv(void* message, int size, int source, int tag) override;
+  TransportRequest isend(const void* message, int size, int dest, int tag) override;
+  TransportRequest irecv(void* message, int size, int source, int tag) override;
+  int probe(int source, int tag) override;
+
+  void bcast(void* message, int size, int root) override;
+  TransportRequest ibcast(void* message, int size, int root) override;
+  uint32_t allreduce_min(uint32_t value) override;
+  void reduce_bitwise_or(const uint32_t* send_data, uint32_t* recv_data, int count, int root) override;
+  void barrier() override;
+  TransportRequest ineighbor_alltoall(const void* send_data, void* recv_data, int size) override;
+
+  void wait(TransportRequest& request) override;
+  void waitall(std::vector<TransportRequest>& requests) override;
+  bool test(TransportRequest& request) override;
+};
+
+// Transport over MPI_COMM_WORLD, the default one of the MPI nodes
+Transport& mpi_world();
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "types.h"
+#include "util.h"
+#include "link_cut_tree.h"
+
+// A dynamic forest kept as a randomized rake and compress (RC) contraction. Every vertex is split
+// into a chain of nodes with at most one forest edge each, so no node has more than three
+// neighbors. In every round of the contraction a leaf rakes into its neighbor and a degree two
+// node with a higher random priority than its degree two neighbors compresses its two edges
+// into one edge holding the maximum of both. Links and cuts recompute only the rounds of the
+// nodes near a change, and path queries climb the rounds from both endpoints. Both take
+// O(log n) time in expectation on any forest, including long paths.
+class RCTree {
+  // The edges of a node in one round of the contraction
+  struct Round {
+    uint8_t degree = 0;
+    uint32_t neighbors[3];
+    // Maximum edge on the path each edge stands for, see edge_key
+    uint64_t values[3];
+  };
+  // Node i is alive in rounds [0, rounds[i].size()) and contracted in the last of them
+  std::vector<std::vector<Round>> rounds;
+  std::vector<node_id_t> owner;        // the vertex whose chain the node belongs to
+  std::vector<uint32_t> partner;       // node at the other end of the node's forest edge
+  std::vector<uint32_t> edge_weight;   // weight of the node's forest edge
+  std::vector<uint32_t> chain_tail;    // last node of each vertex's chain
+  std::vector<std::vector<uint32_t>> free_nodes;  // chain nodes of each vertex without a forest edge
+  std::unordered_map<edge_id_t, uint32_t> edge_nodes;  // node of the lower endpoint of each forest edge
+  uint64_t seed;
+
+  // Nodes changed in the round being propagated and the nodes to recompute in the next one
+  std::vector<uint32_t> changed;
+  std::vector<uint32_t> recompute;
+  std::vector<uint32_t> visit_stamp;
+  uint32_t current_stamp = 0;
+
+  // Edges compare by key, 0 stands for a chain edge and every forest edge is above it
+  uint64_t edge_key(uint32_t node) { return ((uint64_t)edge_weight[node]+1) << 32 | node; }
+  // Random order of the nodes in a round, drawn from the seed
+  bool outranks(uint32_t node, uint32_t other, uint32_t round);
+  bool contracts(uint32_t node, uint32_t round);
+  void add_base_edge(uint32_t a, uint32_t b, uint64_t value);
+  void remove_base_edge(uint32_t a, uint32_t b);
+  // Take a node of v's chain without a forest edge, growing the chain if there is none
+  uint32_t take_free_node(node_id_t v);
+  // Redo the contraction from round 0 after the base edges of the changed nodes were modified
+  void propagate();
+  void mark(uint32_t node);
+
+  public:
+    RCTree(node_id_t num_nodes, uint64_t seed = 0);
+
+    // Given nodes v and w, link the trees containing v and w by adding the edge(v, w)
+    void link(node_id_t v, node_id_t w, uint32_t weight);
+    // Given nodes v and w, divide the tree containing v and w by deleting the edge(v, w)
+    void cut(node_id_t v, node_id_t w);
+
+    // A node standing for the tree containing v, the same for every vertex of the tree
+    uint32_t find_root(node_id_t v);
+
+    // Check if v and w are connected and if so also return the maximum weight edge on their path
+    PathMaxResult connected_path_max(node_id_t v, node_id_t w);
+    std::vector<PathMaxResult> connected_path_max(const std::vector<std::pair<node_id_t, node_id_t>>& queries);
+    bool has_edge(node_id_t v1, node_id_t v2);
+    uint32_t get_edge_weight(node_id_t v1, node_id_t v2);
+};
@@ -5,6 +5,7 @@
 
 #include <sketchless_skiplist.h>
 #include "types.h"
+#include "graph_config.h"
 
 class SketchlessEulerTourNode {
 
@@ -12,6 +13,7 @@ class SketchlessEulerTourNode {
 
   SketchlessSkipListNode* allowed_caller = nullptr;
   long seed = 0;
+  const GraphConfig* config = nullptr;
 
   SketchlessSkipListNode* make_edge(SketchlessEulerTourNode* other);
   void delete_edge(SketchlessEulerTourNode* other);
@@ -20,7 +22,7 @@ public:
   const node_id_t vertex = 0;
   const uint32_t tier = 0;
 
-  SketchlessEulerTourNode(long seed, node_id_t vertex, uint32_t tier);
+  SketchlessEulerTourNode(long seed, node_id_t vertex, uint32_t tier, const GraphConfig* config);
   SketchlessEulerTourNode(long seed);
   ~SketchlessEulerTourNode();
   bool link(SketchlessEulerTourNode& other);
@@ -28,6 +30,12 @@ public:
 
   bool isvalid() const;
 
+  // Build the sentinel skiplist for this vertex if it has not been used yet
+  void touch();
+  // Untouched vertices are singletons with no skiplist
+  bool is_touched() const;
+
+  // Returns nullptr for an untouched vertex
   SketchlessSkipListNode* get_root();
 
   bool has_edge_to(SketchlessEulerTourNode* other);
@@ -35,16 +43,20 @@ public:
   std::set<SketchlessEulerTourNode*> get_component();
 
   long get_seed() {return seed;};
+  const GraphConfig* get_config() {return config;};
 
   friend std::ostream& operator<<(std::ostream& os, const SketchlessEulerTourNode& ett);
 };
 
 class SketchlessEulerTourTree {
   long seed = 0;
+  const GraphConfig config;  // every node of this tree points here
 public:
   std::vector<SketchlessEulerTourNode> ett_nodes;
 
-  SketchlessEulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed);
+  SketchlessEulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed, const GraphConfig& config = default_graph_config());
+  SketchlessEulerTourTree(const SketchlessEulerTourTree&) = delete;
+  SketchlessEulerTourTree& operator=(const SketchlessEulerTourTree&) = delete;
   
   void link(node_id_t u, node_id_t v);
   void cut(node_id_t u, node_id_t v);
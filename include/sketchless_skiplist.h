@@ -4,6 +4,7 @@
 
 class SketchlessEulerTourNode;
 
+// Defaults for graphs constructed without a GraphConfig
 extern long sketchless_skiplist_seed;
 extern double sketchless_height_factor;
 
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <gtest/gtest.h>
+#include <vector>
 #include "sketch.h"
+#include "graph_config.h"
 
 class EulerTourNode;
 
 constexpr int skiplist_buffer_cap = 25;
+// Defaults for graphs constructed without a GraphConfig
 extern long skiplist_seed;
 extern double height_factor;
 extern vec_t sketch_len;
@@ -26,12 +29,17 @@ class SkipListNode {
 
 public:
   Sketch* sketch_agg = nullptr;
+  // Aggregates of the tiers sharing this list's forest, one for each of shared_seeds,
+  // present exactly when sketch_agg is
+  std::vector<Sketch*> shared_aggs;
 
   uint32_t size = 1;
 
   EulerTourNode* node;
+  const GraphConfig* config;
+  const std::vector<long>* shared_seeds;
 
-  SkipListNode(EulerTourNode* node, long seed, bool has_sketch);
+  SkipListNode(EulerTourNode* node, const GraphConfig* config, const std::vector<long>* shared_seeds, long seed, bool has_sketch);
   ~SkipListNode();
   static SkipListNode* init_element(EulerTourNode* node, bool is_allowed_caller);
   void uninit_element(bool delete_bdry);
@@ -54,6 +62,18 @@ public:
   SkipListNode* update_path_agg(vec_t update_idx);
   // Add the given sketch to all aggregate sketches from the current node to its root
   SkipListNode* update_path_agg(Sketch* sketch);
+  // Add the given sketch to the aggregates of one shared tier from the current node to its root
+  SkipListNode* update_shared_path_agg(uint32_t shared_tier, Sketch* sketch);
+  // Add all the aggregates of other to those from the current node to its root
+  SkipListNode* update_path_agg(SkipListNode* other);
+
+  // Add all the aggregates of other to this node's, both must have sketches
+  void merge_aggs(SkipListNode* other);
+  void zero_aggs();
+  // Give this node and the nodes above it in its column an empty aggregate for a new shared tier
+  void add_column_shared_agg(long seed);
+  // Drop the aggregates of the shared tiers from shared_tier on in this node's column
+  void remove_column_shared_aggs(uint32_t shared_tier);
 
   // Update just this node's aggregate sketch
   void update_agg(vec_t update_idx);
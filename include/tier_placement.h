@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.h"
+
+
+// Assignment of tiers to the MPI ranks after the input node. Every rank hosts a
+// contiguous range of tiers. When there are fewer ranks than tiers the ranks of the
+// upper tiers, which are the cheapest to maintain, get the extra tiers.
+class TierPlacement {
+  uint32_t num_tiers;
+  uint32_t num_ranks;   // tier ranks, the input node is not counted
+  uint32_t base_tiers;  // tiers on every rank below the first one with an extra tier
+  uint32_t split_rank;  // first rank (counting from 0) hosting base_tiers+1 tiers
+public:
+  TierPlacement(uint32_t num_tiers, uint32_t num_ranks);
+
+  uint32_t get_num_ranks() { return num_ranks; }
+
+  // MPI rank in MPI_COMM_WORLD of the node hosting tier
+  int rank_of(uint32_t tier);
+  // First tier and number of tiers hosted by an MPI rank in MPI_COMM_WORLD
+  uint32_t first_tier(int rank);
+  uint32_t num_tiers_on(int rank);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+
+typedef struct {
+  std::function<void(uint32_t)> func;
+  std::atomic<uint32_t> remaining;
+} TierJob;
+
+// Single producer single consumer ring of jobs for one tier
+class TierJobQueue {
+  static constexpr uint32_t capacity = 16;
+  alignas(64) std::atomic<uint32_t> head{0};
+  alignas(64) std::atomic<uint32_t> tail{0};
+  TierJob* jobs[capacity];
+public:
+  bool push(TierJob* job);
+  bool pop(TierJob*& job);
+};
+
+// Persistent workers that each own a fixed set of tiers. Work for a tier is
+// always run by the same worker so its Euler tour tree stays in that worker's cache.
+class TierThreadPool {
+  uint32_t num_tiers;
+  uint32_t num_workers;
+  std::vector<TierJobQueue> queues;  // one queue for each tier
+  std::vector<std::thread> workers;
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> epoch{0};
+  std::atomic<uint32_t> sleepers{0};
+  std::mutex sleep_lock;
+  std::condition_variable sleep_cv;
+
+  void worker_main(uint32_t worker_id);
+  void wake_workers();
+public:
+  // num_threads of 0 uses omp_get_max_threads() so OMP_NUM_THREADS sets the pool size
+  TierThreadPool(uint32_t num_tiers, uint32_t num_threads = 0);
+  ~TierThreadPool();
+
+  uint32_t get_num_workers() { return num_workers; }
+
+  // Run func(tier) for every tier in [first, last) on its owning worker and wait for completion,
+  // calling poll on the calling thread while it waits
+  void for_tiers(uint32_t first, uint32_t last, std::function<void(uint32_t)> func,
+      std::function<void()> poll = nullptr);
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// A nonblocking operation of a Transport, null once it has completed
+struct TransportOperation {
+  virtual ~TransportOperation() {}
+};
+typedef std::unique_ptr<TransportOperation> TransportRequest;
+
+// Communication between the input node, the tier nodes and the query node. Ranks count from 0 and
+// every rank calls the collectives of a transport in the same order, nonblocking ones included,
+// and a nonblocking collective only matches the same nonblocking collective on the other ranks.
+// Messages from one rank to another with the same tag arrive in the order they were sent.
+class Transport {
+public:
+  virtual ~Transport() {}
+
+  virtual int rank() = 0;
+  virtual int size() = 0;
+  // Collective, a transport over the same ranks whose traffic is independent of this one
+  virtual std::unique_ptr<Transport> dup() = 0;
+  // Collective, a transport over the ranks passing member true, which keep their order.
+  // The other ranks get nullptr
+  virtual std::unique_ptr<Transport> split(bool member) = 0;
+  // Collective, a transport over the same ranks for neighbor exchanges along a directed graph.
+  // This rank receives from the ranks in sources and sends to the ranks in destinations
+  virtual std::unique_ptr<Transport> neighbors(const std::vector<int>& sources, const std::vector<int>& destinations) = 0;
+
+  virtual void send(const void* message, int size, int dest, int tag) = 0;
+  virtual void recv(void* message, int size, int source, int tag) = 0;
+  virtual TransportRequest isend(const void* message, int size, int dest, int tag) = 0;
+  virtual TransportRequest irecv(void* message, int size, int source, int tag) = 0;
+  // Wait for a message and return its size in bytes without receiving it
+  virtual int probe(int source, int tag) = 0;
+
+  virtual void bcast(void* message, int size, int root) = 0;
+  virtual TransportRequest ibcast(void* message, int size, int root) = 0;
+  virtual uint32_t allreduce_min(uint32_t value) = 0;
+  // recv_data is only written on root
+  virtual void reduce_bitwise_or(const uint32_t* send_data, uint32_t* recv_data, int count, int root) = 0;
+  virtual void barrier() = 0;
+  // Collective over a transport from neighbors(). Block i of send_data goes to the i-th destination
+  // and block i of recv_data comes from the i-th source, every block is size bytes
+  virtual TransportRequest ineighbor_alltoall(const void* send_data, void* recv_data, int size) = 0;
+
+  virtual void wait(TransportRequest& request) = 0;
+  virtual void waitall(std::vector<TransportRequest>& requests) = 0;
+  // Complete the request if it is done without waiting for it
+  virtual bool test(TransportRequest& request) = 0;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <utility>
+
+#include "types.h"
+#include "sketch.h"
+
+
+// Messages exchanged between the MPI nodes. They are sent as raw bytes, so every
+// one is packed and any change to a layout below must bump the version.
+constexpr uint8_t WIRE_FORMAT_VERSION = 1;
+
+enum TreeOperationType : uint8_t {
+  NOT_ISOLATED=0, ISOLATED=1, EMPTY, LINK, CUT, LCT_QUERY
+};
+
+enum BatchFlags : uint8_t {
+  BATCH_END = 1,
+  BATCH_SLIDING_WINDOW = 2,
+  BATCH_CONCURRENT_REFRESH = 4,
+  BATCH_VARINT = 8,  // the payload uses the varint encoding
+  BATCH_REPLICATED_LCT = 32  // the tier nodes answer the cycle queries from their own copy of the forest
+};
+
+// Sent before every batch so the tier nodes can size the payload broadcast
+typedef struct __attribute__((packed)) {
+  uint8_t version = WIRE_FORMAT_VERSION;
+  uint8_t flags = 0;
+  uint32_t num_updates = 0;
+  uint32_t payload_bytes = 0;
+} BatchHeader;
+
+typedef struct __attribute__((packed)) {
+  TreeOperationType type = EMPTY;
+  node_id_t endpoint1 = 0;
+  node_id_t endpoint2 = 0;
+  uint32_t start_tier = 0;
+} EttUpdateMessage;
+
+// Forest changes for one isolated endpoint on a tier, cut.type is EMPTY if the new edge closes no cycle
+typedef struct __attribute__((packed)) {
+  EttUpdateMessage cut;
+  EttUpdateMessage link;
+} EttRefreshStepMessage;
+
+typedef struct __attribute__((packed)) {
+  TreeOperationType type = EMPTY;
+  node_id_t endpoint1 = 0;
+  node_id_t endpoint2 = 0;
+} LctQueryMessage;
+
+enum QueryNodeMessageType : uint8_t {
+  FOREST_CHANGES, CONNECTIVITY_QUERY, CC_QUERY, QUERY_NODE_END
+};
+
+// Sent from the input node to the query node. FOREST_CHANGES is followed in the same message by
+// num_changes EttUpdateMessages, all the cuts before the links
+typedef struct __attribute__((packed)) {
+  QueryNodeMessageType type = FOREST_CHANGES;
+  uint32_t num_changes = 0;
+  node_id_t a = 0;
+  node_id_t b = 0;
+} QueryNodeMessage;
+
+typedef struct __attribute__((packed)) {
+  bool connected = false;
+  edge_id_t cycle_edge = 0;
+  uint32_t weight = 0;
+} LctResponseMessage;
+
+typedef struct __attribute__((packed)) {
+  node_id_t v = 0;
+  uint32_t prev_tier_size = 0;
+  vec_t sample_idx = 0;
+  uint8_t sample_result = ZERO;
+} RefreshEndpoint;
+
+typedef struct {
+  std::pair<RefreshEndpoint, RefreshEndpoint> endpoints;
+} RefreshMessage;
+
+typedef struct {
+  uint32_t size1 = 0;
+  uint32_t size2 = 0;
+} GreedyRefreshMessage;
+
+// Batch payloads. The fixed encoding is 8 bytes per update with the update type in the
+// top bit of the source vertex. The varint encoding writes the source as a zigzag delta
+// from the previous source with the type in its low bit, then the destination as a
+// zigzag delta from the source, which is smaller for streams with nearby vertex ids.
+constexpr uint32_t max_payload_bytes(uint32_t num_updates) { return 8*num_updates; }
+// Encode the updates into out, which must hold max_payload_bytes(num_updates) bytes.
+// Returns the number of bytes written and adds BATCH_VARINT to flags if that encoding was used.
+uint32_t encode_updates(const GraphUpdate* updates, uint32_t num_updates, uint8_t* out, uint8_t& flags);
+void decode_updates(const uint8_t* in, uint32_t num_updates, uint8_t flags, GraphUpdate* updates);
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+declare base_dir="$(dirname $(dirname $(realpath $0)))"
+
+# Build one copy of the code for each dynamic tree backend
+for backend in LCT RC_TREE; do
+  mkdir -p ${base_dir}/build_${backend}
+  cd ${base_dir}/build_${backend}
+  set -e
+  cmake -DDYNAMIC_TREE=${backend} ..
+  make -j
+  set +e
+  ln -sfn ${base_dir}/build/binary_streams binary_streams
+done
+
+mkdir -p ${base_dir}/results
+
+# Head to head on the dynamic trees alone: links, path max queries and cut, query, link rounds
+# on a long path and on a random tree, appended to results/dynamic_tree_results.txt
+cd ${base_dir}/build_LCT
+./dynamicCC_tests --gtest_filter=*path_max_speed_test*
+cat dynamic_tree_results.txt >> ${base_dir}/results/dynamic_tree_results.txt
+rm dynamic_tree_results.txt
+
+for backend in LCT RC_TREE; do
+  cd ${base_dir}/build_${backend}
+  echo "DYNAMIC TREE BACKEND: ${backend}"
+
+  # OMP VERSION
+  ./dynamicCC_tests binary_streams/kron_13_stream_binary --gtest_filter=*omp_speed*
+  ./dynamicCC_tests binary_streams/kron_15_stream_binary --gtest_filter=*omp_speed*
+  ./dynamicCC_tests binary_streams/dnc_streamified_binary --gtest_filter=*omp_speed*
+  ./dynamicCC_tests binary_streams/tech_streamified_binary --gtest_filter=*omp_speed*
+  ./dynamicCC_tests binary_streams/enron_streamified_binary --gtest_filter=*omp_speed*
+
+  # MPI VERSION, DEFAULT BATCH SIZE (100), DEFAULT SKIPLIST HEIGHT FACTOR (1 / log log n)
+  mpirun -np 23 ./mpi_dynamicCC_tests binary_streams/kron_13_stream_binary 0 0 --gtest_filter=*mpi_update_speed_test*
+  mpirun -np 26 --bind-to hwthread ./mpi_dynamicCC_tests binary_streams/kron_15_stream_binary 0 0 --gtest_filter=*mpi_update_speed_test*
+  mpirun -np 19 ./mpi_dynamicCC_tests binary_streams/dnc_streamified_binary 0 0 --gtest_filter=*mpi_update_speed_test*
+  mpirun -np 26 --bind-to hwthread ./mpi_dynamicCC_tests binary_streams/tech_streamified_binary 0 0 --gtest_filter=*mpi_update_speed_test*
+  mpirun -np 29 --bind-to hwthread ./mpi_dynamicCC_tests binary_streams/enron_streamified_binary 0 0 --gtest_filter=*mpi_update_speed_test*
+done
@@ -0,0 +1,66 @@
+#!/bin/bash
+
+# Write an Open MPI rankfile that keeps the chain of tier nodes together. The input node and the
+# query node take the first cores, then ranks 1, 2, ... fill the cores of one socket before moving
+# to the next socket and the next host. Tier ranks only exchange sizes and refreshes with the ranks
+# next to them, so adjacent tiers share a socket except where the chain crosses a socket boundary.
+#
+# usage: make_rankfile.sh num_processes hosts sockets_per_host cores_per_socket [cores_per_rank] [query_node]
+#   hosts is a comma separated list of host names
+#   cores_per_rank is the number of cores bound to every rank, 1 by default
+#   query_node is 1 when the last rank runs a QueryNode, 0 by default
+# then run: mpirun -np num_processes --rankfile <file> ./mpi_dynamicCC_tests ...
+
+if [ $# -lt 4 ]; then
+  echo "usage: $0 num_processes hosts sockets_per_host cores_per_socket [cores_per_rank] [query_node]" >&2
+  exit 1
+fi
+
+declare num_processes=$1
+declare -a hosts=(${2//,/ })
+declare sockets_per_host=$3
+declare cores_per_socket=$4
+declare cores_per_rank=${5:-1}
+declare query_node=${6:-0}
+
+if [ ${cores_per_rank} -gt ${cores_per_socket} ]; then
+  echo "A rank cannot have more cores than a socket" >&2
+  exit 1
+fi
+
+# Ranks in the order they get cores
+declare -a order=(0)
+if [ ${query_node} -eq 1 ]; then
+  order+=($((num_processes-1)))
+  declare last_tier_rank=$((num_processes-2))
+else
+  declare last_tier_rank=$((num_processes-1))
+fi
+for ((rank = 1; rank <= last_tier_rank; rank++)); do
+  order+=(${rank})
+done
+
+declare host_idx=0
+declare socket=0
+declare core=0
+for rank in ${order[@]}; do
+  # A rank never spans two sockets
+  if [ $((core+cores_per_rank)) -gt ${cores_per_socket} ]; then
+    core=0
+    socket=$((socket+1))
+  fi
+  if [ ${socket} -eq ${sockets_per_host} ]; then
+    socket=0
+    host_idx=$((host_idx+1))
+  fi
+  if [ ${host_idx} -eq ${#hosts[@]} ]; then
+    echo "Not enough cores for ${num_processes} ranks" >&2
+    exit 1
+  fi
+  if [ ${cores_per_rank} -eq 1 ]; then
+    echo "rank ${rank}=${hosts[${host_idx}]} slot=${socket}:${core}"
+  else
+    echo "rank ${rank}=${hosts[${host_idx}]} slot=${socket}:${core}-$((core+cores_per_rank-1))"
+  fi
+  core=$((core+cores_per_rank))
+done
@@ -0,0 +1,28 @@
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include "../include/batch_reorder.h"
+#include "../include/util.h"
+
+
+uint32_t reorder_batch(GraphUpdate* updates, uint32_t num_updates, DynamicTree& forest) {
+    // An update that is not the deletion of a forest edge cannot disconnect a tree, so those run
+    // first and the greedy check commits them before reaching the deletions that cause isolations
+    std::unordered_set<edge_id_t> deferred_edges;
+    std::vector<GraphUpdate> deferred_updates;
+    uint32_t kept_updates = 0;
+    for (uint32_t i = 0; i < num_updates; i++) {
+        GraphUpdate update = updates[i];
+        edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
+        if ((update.type == DELETE && forest.has_edge(update.edge.src, update.edge.dst))
+                || deferred_edges.find(edge) != deferred_edges.end()) {
+            deferred_edges.insert(edge);
+            deferred_updates.push_back(update);
+        } else {
+            updates[kept_updates++] = update;
+        }
+    }
+    std::copy(deferred_updates.begin(), deferred_updates.end(), &updates[kept_updates]);
+    return kept_updates;
+}
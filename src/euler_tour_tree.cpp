@@ -1,23 +1,80 @@
 #include <cassert>
+#include <unordered_set>
 
 #include <euler_tour_tree.h>
 
-EulerTourTree::EulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed) {
-  // Initialize all the ETT node
+EulerTourTree::EulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed, const GraphConfig& config) : config(config) {
+  // Initialize all the ETT nodes, their skiplists are only built once the vertex is touched
     ett_nodes.reserve(num_nodes);
     for (node_id_t i = 0; i < num_nodes; ++i) {
-        ett_nodes.emplace_back(seed, i, tier_num);
+        ett_nodes.emplace_back(seed, i, tier_num, &this->config, &this->shared_seeds);
     }
-    // Initialize the temp_sketch
-    this->temp_sketch = new Sketch(sketch_len, seed, 1, sketch_err);
+    // Initialize the aggregates carried between skiplist nodes of a vertex
+    this->temp_aggs = new SkipListNode(nullptr, &this->config, &this->shared_seeds, seed, true);
+}
+
+EulerTourTree::~EulerTourTree() {
+  // Every skiplist node is either in the column of an element or the first boundary column of its list
+  std::vector<SkipListNode*> elements;
+  std::unordered_set<SkipListNode*> boundaries;
+  for (EulerTourNode& node : ett_nodes) {
+    for (auto edge : node.edges) {
+      elements.push_back(edge.second);
+      boundaries.insert(edge.second->get_first());
+    }
+  }
+  for (SkipListNode* element : elements)
+    element->uninit_element(false);
+  for (SkipListNode* boundary : boundaries)
+    boundary->uninit_element(false);
+  delete temp_aggs;
+}
+
+std::vector<SkipListNode*> EulerTourTree::get_columns() {
+  std::vector<SkipListNode*> columns;
+  std::unordered_set<SkipListNode*> boundaries;
+  for (EulerTourNode& node : ett_nodes) {
+    for (auto edge : node.edges) {
+      columns.push_back(edge.second);
+      boundaries.insert(edge.second->get_first());
+    }
+  }
+  columns.insert(columns.end(), boundaries.begin(), boundaries.end());
+  return columns;
+}
+
+void EulerTourTree::add_shared_tier(long seed) {
+  shared_seeds.push_back(seed);
+  temp_aggs->shared_aggs.push_back(new Sketch(config.sketch_len, seed, 1, config.sketch_err));
+  for (SkipListNode* column : get_columns())
+    column->add_column_shared_agg(seed);
+}
+
+void EulerTourTree::remove_shared_tiers(uint32_t shared_tier) {
+  for (SkipListNode* column : get_columns())
+    column->remove_column_shared_aggs(shared_tier);
+  temp_aggs->remove_column_shared_aggs(shared_tier);
+  shared_seeds.resize(shared_tier);
+}
+
+void EulerTourTree::merge_shared_sketch(uint32_t shared_tier, node_id_t u, Sketch* sketch) {
+  ett_nodes[u].touch();
+  ett_nodes[u].allowed_caller->update_shared_path_agg(shared_tier, sketch);
+}
+
+Sketch* EulerTourTree::get_shared_vertex_sketch(uint32_t shared_tier, node_id_t u) {
+  if (!ett_nodes[u].is_touched())
+    return nullptr;
+  ett_nodes[u].allowed_caller->process_updates();
+  return ett_nodes[u].allowed_caller->shared_aggs[shared_tier];
 }
 
 void EulerTourTree::link(node_id_t u, node_id_t v) {
-  ett_nodes[u].link(ett_nodes[v], temp_sketch);
+  ett_nodes[u].link(ett_nodes[v], temp_aggs);
 }
 
 void EulerTourTree::cut(node_id_t u, node_id_t v) {
-  ett_nodes[u].cut(ett_nodes[v], temp_sketch);
+  ett_nodes[u].cut(ett_nodes[v], temp_aggs);
 }
 
 bool EulerTourTree::has_edge(node_id_t u, node_id_t v) {
@@ -28,7 +85,9 @@ SkipListNode* EulerTourTree::update_sketch(node_id_t u, vec_t update_idx) {
   return ett_nodes[u].update_sketch(update_idx);
 }
 
-std::pair<SkipListNode*, SkipListNode*> EulerTourTree::update_sketches(node_id_t u, node_id_t v, vec_t update_idx) {
+SketchUpdateResult EulerTourTree::update_sketches(node_id_t u, node_id_t v, vec_t update_idx) {
+  ett_nodes[u].touch();
+  ett_nodes[v].touch();
   // Update the paths in lockstep, stopping at the first common node
   SkipListNode* curr1 = ett_nodes[u].allowed_caller;
   SkipListNode* curr2 = ett_nodes[v].allowed_caller;
@@ -36,7 +95,7 @@ std::pair<SkipListNode*, SkipListNode*> EulerTourTree::update_sketches(node_id_t
 	while (curr1 || curr2) {
     if (curr1 == curr2) {
       SkipListNode* root  = curr1->get_root();
-      return {root, root};
+      return {root, root, true};
     }
     if (curr1) {
       curr1->update_agg(update_idx);
@@ -49,7 +108,28 @@ std::pair<SkipListNode*, SkipListNode*> EulerTourTree::update_sketches(node_id_t
       curr2 = prev2->get_parent();
     }
 	}
-	return {prev1, prev2};
+	return {prev1, prev2, prev1 == prev2};
+}
+
+void EulerTourTree::merge_sketch(node_id_t u, Sketch* sketch) {
+  ett_nodes[u].touch();
+  ett_nodes[u].allowed_caller->update_path_agg(sketch);
+}
+
+Sketch* EulerTourTree::get_vertex_sketch(node_id_t u) {
+  if (!ett_nodes[u].is_touched())
+    return nullptr;
+  ett_nodes[u].allowed_caller->process_updates();
+  return ett_nodes[u].allowed_caller->sketch_agg;
+}
+
+std::vector<std::pair<node_id_t, node_id_t>> EulerTourTree::get_edges() {
+  std::vector<std::pair<node_id_t, node_id_t>> forest_edges;
+  for (EulerTourNode& node : ett_nodes)
+    for (auto edge : node.edges)
+      if (edge.first && node.vertex < edge.first->vertex)
+        forest_edges.push_back({node.vertex, edge.first->vertex});
+  return forest_edges;
 }
 
 SkipListNode* EulerTourTree::get_root(node_id_t u) {
@@ -64,15 +144,10 @@ uint32_t EulerTourTree::get_size(node_id_t u) {
   return ett_nodes[u].get_size();
 }
 
-EulerTourNode::EulerTourNode(long seed, node_id_t vertex, uint32_t tier) : seed(seed), vertex(vertex), tier(tier) {
-  // Initialize sentinel
-  this->make_edge(nullptr, nullptr);
-}
+EulerTourNode::EulerTourNode(long seed, node_id_t vertex, uint32_t tier, const GraphConfig* config,
+    const std::vector<long>* shared_seeds) : seed(seed), config(config), shared_seeds(shared_seeds), vertex(vertex), tier(tier) {}
 
-EulerTourNode::EulerTourNode(long seed) : seed(seed) {
-  // Initialize sentinel
-  this->make_edge(nullptr, nullptr);
-}
+EulerTourNode::EulerTourNode(long seed) : seed(seed) {}
 
 EulerTourNode::~EulerTourNode() {
   // Final boundary nodes are a memory leak
@@ -81,16 +156,16 @@ EulerTourNode::~EulerTourNode() {
   //   edge.second->uninit_element(false);
 }
 
-SkipListNode* EulerTourNode::make_edge(EulerTourNode* other, Sketch* temp_sketch) {
+SkipListNode* EulerTourNode::make_edge(EulerTourNode* other, SkipListNode* temp) {
   assert(!other || this->tier == other->tier);
   //Constructing a new SkipListNode with pointer to this ETT object
   SkipListNode* node;
   if (allowed_caller == nullptr) {
     node = SkipListNode::init_element(this, true);
     allowed_caller = node;
-    if (temp_sketch != nullptr) {
-      node->update_path_agg(temp_sketch);
-      temp_sketch->zero_contents();
+    if (temp != nullptr) {
+      node->update_path_agg(temp);
+      temp->zero_aggs();
     }
   } else {
     node = SkipListNode::init_element(this, false);
@@ -100,7 +175,7 @@ SkipListNode* EulerTourNode::make_edge(EulerTourNode* other, Sketch* temp_sketch
   //Returns the new node pointer or the one that already existed if it did
 }
 
-void EulerTourNode::delete_edge(EulerTourNode* other, Sketch* temp_sketch) {
+void EulerTourNode::delete_edge(EulerTourNode* other, SkipListNode* temp) {
   assert(!other || this->tier == other->tier);
   SkipListNode* node_to_delete = this->edges[other];
   this->edges.erase(other);
@@ -109,34 +184,54 @@ void EulerTourNode::delete_edge(EulerTourNode* other, Sketch* temp_sketch) {
       allowed_caller = nullptr;
       node_to_delete->process_updates();
       // std::cout << node_to_delete << std::endl;
-      temp_sketch->merge(*node_to_delete->sketch_agg);
-      node_to_delete->sketch_agg = nullptr;
+      // The sketches are freed with the node below once their contents are carried over
+      temp->merge_aggs(node_to_delete);
     } else {
       allowed_caller = this->edges.begin()->second;
       node_to_delete->process_updates();
       allowed_caller->update_path_agg(node_to_delete->sketch_agg);
       node_to_delete->sketch_agg = nullptr; // We just gave the sketch to new allowed caller
+      for (uint32_t i = 0; i < node_to_delete->shared_aggs.size(); i++) {
+        allowed_caller->update_shared_path_agg(i, node_to_delete->shared_aggs[i]);
+        node_to_delete->shared_aggs[i] = nullptr;
+      }
     }
   }
   node_to_delete->uninit_element(true);
 }
 
+void EulerTourNode::touch() {
+  // Initialize sentinel the first time this vertex is used
+  if (this->edges.empty())
+    this->make_edge(nullptr, nullptr);
+}
+
+bool EulerTourNode::is_touched() const {
+  return !this->edges.empty();
+}
+
 SkipListNode* EulerTourNode::update_sketch(vec_t update_idx) {
-  assert(allowed_caller);
+  this->touch();
   return this->allowed_caller->update_path_agg(update_idx);
 }
 
 SkipListNode* EulerTourNode::get_root() {
+  if (!this->is_touched())
+    return nullptr;
   return this->allowed_caller->get_root();
 }
 
 //Get the aggregate sketch at the root of the ETT for this node
 Sketch* EulerTourNode::get_aggregate() {
-  assert(allowed_caller);
+  if (!this->is_touched())
+    return nullptr;
   return this->allowed_caller->get_list_aggregate();
 }
 
 uint32_t EulerTourNode::get_size() {
+  // An untouched vertex is a singleton tour, its element plus the boundary node
+  if (!this->is_touched())
+    return 2;
   return this->allowed_caller->get_list_size();
 }
 
@@ -145,11 +240,15 @@ bool EulerTourNode::has_edge_to(EulerTourNode* other) {
 }
 
 std::set<EulerTourNode*> EulerTourNode::get_component() {
+  if (!this->is_touched())
+    return {this};
   return this->allowed_caller->get_component();
 }
 
-bool EulerTourNode::link(EulerTourNode& other, Sketch* temp_sketch) {
+bool EulerTourNode::link(EulerTourNode& other, SkipListNode* temp) {
   assert(this->tier == other.tier);
+  this->touch();
+  other.touch();
   SkipListNode* this_sentinel = this->edges.begin()->second->get_last();
   SkipListNode* other_sentinel = other.edges.begin()->second->get_last();
 
@@ -176,7 +275,7 @@ bool EulerTourNode::link(EulerTourNode& other, Sketch* temp_sketch) {
 
   // Unlink and destroy other_sentinel
   SkipListNode* aux_other = SkipListNode::split_left(other_sentinel);
-  other_sentinel->node->delete_edge(nullptr, temp_sketch);
+  other_sentinel->node->delete_edge(nullptr, temp);
 
   SkipListNode* aux_other_left, *aux_other_right;
   if (aux_other == nullptr) {
@@ -191,8 +290,8 @@ bool EulerTourNode::link(EulerTourNode& other, Sketch* temp_sketch) {
   // R  LR           L    R  LR           L
   // N                    N
 
-  SkipListNode* aux_edge_left = this->make_edge(&other, temp_sketch);
-  SkipListNode* aux_edge_right = other.make_edge(this, temp_sketch);
+  SkipListNode* aux_edge_left = this->make_edge(&other, temp);
+  SkipListNode* aux_edge_right = other.make_edge(this, temp);
 
   SkipListNode::join(aux_this_left, aux_edge_left, aux_other_right,
       aux_other_left, aux_edge_right, aux_this_right);
@@ -200,7 +299,7 @@ bool EulerTourNode::link(EulerTourNode& other, Sketch* temp_sketch) {
   return true;
 }
 
-bool EulerTourNode::cut(EulerTourNode& other, Sketch* temp_sketch) {
+bool EulerTourNode::cut(EulerTourNode& other, SkipListNode* temp) {
   assert(this->tier == other.tier);
   if (this->edges.find(&other) == this->edges.end()) {
     assert(other.edges.find(this) == other.edges.end());
@@ -212,21 +311,21 @@ bool EulerTourNode::cut(EulerTourNode& other, Sketch* temp_sketch) {
   SkipListNode* frag1r = SkipListNode::split_right(e1);
   bool order_is_e1e2 = e2->get_last() != e1;
   SkipListNode* frag1l = SkipListNode::split_left(e1);
-  this->delete_edge(&other, temp_sketch);
+  this->delete_edge(&other, temp);
   SkipListNode* frag2r = SkipListNode::split_right(e2);
   SkipListNode* frag2l = SkipListNode::split_left(e2);
-  other.delete_edge(this, temp_sketch);
+  other.delete_edge(this, temp);
 
   if (order_is_e1e2) {
     // e1 is to the left of e2
     // e2 should be made into a sentinel
-    SkipListNode* sentinel = other.make_edge(nullptr, temp_sketch);
+    SkipListNode* sentinel = other.make_edge(nullptr, temp);
     SkipListNode::join(frag2l, sentinel);
     SkipListNode::join(frag1l, frag2r);
   } else {
     // e2 is to the left of e1
     // e1 should be made into a sentinel
-    SkipListNode* sentinel = this->make_edge(nullptr, temp_sketch);
+    SkipListNode* sentinel = this->make_edge(nullptr, temp);
     SkipListNode::join(frag2r, sentinel);
     SkipListNode::join(frag2l, frag1r);
   }
@@ -0,0 +1,15 @@
+#include "graph_config.h"
+#include "skiplist.h"
+#include "sketchless_skiplist.h"
+
+
+GraphConfig default_graph_config() {
+	GraphConfig config;
+	config.height_factor = height_factor;
+	config.sketch_len = sketch_len;
+	config.sketch_err = sketch_err;
+	config.skiplist_seed = skiplist_seed;
+	config.sketchless_height_factor = sketchless_height_factor;
+	config.sketchless_skiplist_seed = sketchless_skiplist_seed;
+	return config;
+}
@@ -0,0 +1,46 @@
+#include "../include/graph_host.h"
+#include <cassert>
+
+GraphHost::GraphHost(uint32_t max_graphs, uint32_t batch_size, uint32_t num_threads) :
+    max_graphs(max_graphs), batch_size(batch_size), pool(max_graphs, num_threads) {
+	graphs.reserve(max_graphs);
+	pending.reserve(max_graphs);
+}
+
+uint32_t GraphHost::add_graph(node_id_t num_nodes, const GraphConfig& config, bool collapse_tiers) {
+	assert(graphs.size() < max_graphs);
+	// The graph's own tier pool runs inline, the host pool gives the parallelism
+	graphs.emplace_back(new GraphTiers(num_nodes, 1, collapse_tiers, config));
+	pending.emplace_back();
+	pending.back().reserve(batch_size);
+	return graphs.size()-1;
+}
+
+void GraphHost::flush_graph(uint32_t graph_id) {
+	if (pending[graph_id].empty())
+		return;
+	graphs[graph_id]->update_batch(pending[graph_id]);
+	pending[graph_id].clear();
+}
+
+void GraphHost::update(uint32_t graph_id, GraphUpdate update) {
+	pending[graph_id].push_back(update);
+	if (pending[graph_id].size() >= batch_size)
+		flush();
+}
+
+void GraphHost::flush() {
+	pool.for_tiers(0, graphs.size(), [&](uint32_t graph_id) {
+		flush_graph(graph_id);
+	});
+}
+
+std::vector<std::set<node_id_t>> GraphHost::get_cc(uint32_t graph_id) {
+	flush_graph(graph_id);
+	return graphs[graph_id]->get_cc();
+}
+
+bool GraphHost::is_connected(uint32_t graph_id, node_id_t a, node_id_t b) {
+	flush_graph(graph_id);
+	return graphs[graph_id]->is_connected(a, b);
+}
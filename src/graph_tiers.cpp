@@ -3,27 +3,24 @@
 #include "util.h"
 #include <random>
 #include <atomic>
+#include <cassert>
 
 // #define CANARY(X) do {if (update.edge.src == 1784 && update.edge.dst == 4420) { std::cout << __FILE__ << ":" << __LINE__ << " says " << X << std::endl;}} while (false)
 #define CANARY(X) ;
 // #define ENDPOINT_CANARY(X, src, dst) do {if ((src == 7781 || dst == 7781)) {std::cout << __FILE__ << ":" << __LINE__ << " says " << X << " " << src << " " << dst << std::endl;}} while (false)
 #define ENDPOINT_CANARY(X, src, dst) ;
 
-long lct_time = 0;
-long ett_time = 0;
-long ett_find_root = 0;
-long ett_get_agg = 0;
-long sketch_query = 0;
-long sketch_time = 0;
-long refresh_time = 0;
-long parallel_isolated_check = 0;
-long tiers_grown = 0;
-long normal_refreshes = 0;
-
+static uint32_t get_num_tiers(node_id_t num_nodes) {
+	return log2(num_nodes)/(log2(3)-1);
+}
 
-GraphTiers::GraphTiers(node_id_t num_nodes) : link_cut_tree(num_nodes) {
+GraphTiers::GraphTiers(node_id_t num_nodes, uint32_t num_threads, bool collapse_tiers, const GraphConfig& config) :
+    config(config), num_nodes(num_nodes), tier_state(get_num_tiers(num_nodes)), dynamic_tree(num_nodes), collapse_tiers(collapse_tiers),
+    pool(get_num_tiers(num_nodes), num_threads) {
 	// Algorithm parameters
-	uint32_t num_tiers = log2(num_nodes)/(log2(3)-1);
+	uint32_t num_tiers = get_num_tiers(num_nodes);
+	weight_counts.resize(num_tiers, 0);
+	rep.resize(num_tiers);
 
 	// Initialize all the ETTs
 	std::random_device dev;
@@ -35,143 +32,363 @@ GraphTiers::GraphTiers(node_id_t num_nodes) : link_cut_tree(num_nodes) {
 	dist(rng); // To give 1:1 correspondence with MPI seeds
 	for (uint32_t i = 0; i < num_tiers; i++) {
 		int tier_seed = dist(rng);
-		ett.emplace_back(num_nodes, i, tier_seed);
+		tier_seeds.push_back(tier_seed);
+		// All tiers start with the same empty forest so they can all share the first tier
+		rep[i] = collapse_tiers ? 0 : i;
+		if (rep[i] == i) {
+			ett.emplace_back(new EulerTourTree(num_nodes, i, tier_seed, config));
+		} else {
+			ett.emplace_back(nullptr);
+			ett[0]->add_shared_tier(tier_seed);
+		}
+	}
+}
+
+void GraphTiers::dt_link(node_id_t a, node_id_t b, uint32_t weight) {
+	dynamic_tree.link(a, b, weight);
+	weight_counts[weight]++;
+}
+
+void GraphTiers::dt_cut(node_id_t a, node_id_t b) {
+	weight_counts[dynamic_tree.get_edge_weight(a, b)]--;
+	dynamic_tree.cut(a, b);
+}
+
+Sketch* GraphTiers::tier_aggregate(uint32_t tier, SkipListNode* root) {
+	root->process_updates();
+	// A collapsed tier keeps its aggregates next to its representative's, in the order of the run
+	return rep[tier] == tier ? root->sketch_agg : root->shared_aggs[tier-rep[tier]-1];
+}
+
+SketchSample GraphTiers::sample_tier(uint32_t tier, node_id_t v) {
+	// v is an endpoint of an update, whose sketch update touched it on every tier
+	SkipListNode* root = ett[rep[tier]]->get_root(v);
+	assert(root != nullptr);
+	Sketch* ett_agg = tier_aggregate(tier, root);
+	ett_agg->reset_sample_state();
+	return ett_agg->sample();
+}
+
+void GraphTiers::materialize_tier(uint32_t tier) {
+	uint32_t old_rep = rep[tier];
+	if (old_rep == tier)
+		return;
+	EulerTourTree& from = *ett[old_rep];
+	uint32_t slot = tier-old_rep-1;
+	// Move the vertex sketches of this tier and the rest of the run above it onto the tier's own ETT
+	ett[tier].reset(new EulerTourTree(num_nodes, tier, tier_seeds[tier], config));
+	for (uint32_t i = tier+1; i < ett.size() && rep[i] == old_rep; i++)
+		ett[tier]->add_shared_tier(tier_seeds[i]);
+	for (node_id_t v = 0; v < num_nodes; v++) {
+		Sketch* sketch = from.get_shared_vertex_sketch(slot, v);
+		if (!sketch)
+			continue;
+		ett[tier]->merge_sketch(v, sketch);
+		for (uint32_t i = 0; i < ett[tier]->num_shared_tiers(); i++)
+			ett[tier]->merge_shared_sketch(i, v, from.get_shared_vertex_sketch(slot+1+i, v));
 	}
+	from.remove_shared_tiers(slot);
+	for (auto edge : from.get_edges())
+		ett[tier]->link(edge.first, edge.second);
+	// This tier now represents the rest of the run above it
+	for (uint32_t i = tier; i < ett.size() && rep[i] == old_rep; i++)
+		rep[i] = tier;
+	metrics.tiers_materialized++;
+}
 
-	root_nodes.reserve(num_tiers*2);
+void GraphTiers::collapse_identical_tiers() {
+	updates_since_collapse = 0;
+	for (uint32_t tier = 1; tier < ett.size(); tier++) {
+		// No edge first appears on this tier so its forest is the same as the tier below
+		if (rep[tier] != tier || weight_counts[tier] != 0)
+			continue;
+		// The tiers of this run keep their vertex sketches as extra aggregates in the ETT below
+		EulerTourTree& to = *ett[rep[tier-1]];
+		uint32_t first_slot = to.num_shared_tiers();
+		to.add_shared_tier(tier_seeds[tier]);
+		for (uint32_t i = 0; i < ett[tier]->num_shared_tiers(); i++)
+			to.add_shared_tier(tier_seeds[tier+1+i]);
+		for (node_id_t v = 0; v < num_nodes; v++) {
+			Sketch* sketch = ett[tier]->get_vertex_sketch(v);
+			if (!sketch)
+				continue;
+			to.merge_shared_sketch(first_slot, v, sketch);
+			for (uint32_t i = 0; i < ett[tier]->num_shared_tiers(); i++)
+				to.merge_shared_sketch(first_slot+1+i, v, ett[tier]->get_shared_vertex_sketch(i, v));
+		}
+		ett[tier].reset();
+		for (uint32_t i = tier; i < ett.size() && rep[i] == tier; i++)
+			rep[i] = rep[tier-1];
+		metrics.tiers_collapsed++;
+	}
 }
 
-GraphTiers::~GraphTiers() {}
+void GraphTiers::count_updates(uint32_t num_updates) {
+	if (!collapse_tiers)
+		return;
+	updates_since_collapse += num_updates;
+	// Collapsing and later materializing a tier cost O(n log n), so amortize them over n updates
+	if (updates_since_collapse >= num_nodes)
+		collapse_identical_tiers();
+}
 
 void GraphTiers::update(GraphUpdate update) {
 	edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
 	// Update the sketches of both endpoints of the edge in all tiers
-	if (update.type == DELETE && link_cut_tree.has_edge(update.edge.src, update.edge.dst)) {
-		link_cut_tree.cut(update.edge.src, update.edge.dst);
+	if (update.type == DELETE && dynamic_tree.has_edge(update.edge.src, update.edge.dst)) {
+		dt_cut(update.edge.src, update.edge.dst);
 	}
 	START(su);
-	#pragma omp parallel for
-	for (uint32_t i = 0; i < ett.size(); i++) {
-		if (update.type == DELETE && ett[i].has_edge(update.edge.src, update.edge.dst)) {
-			ett[i].cut(update.edge.src, update.edge.dst);
+	pool.for_tiers(0, ett.size(), [&](uint32_t i) {
+		// Collapsed tiers share their representative's forest, which updates their aggregates too
+		if (rep[i] != i)
+			return;
+		if (update.type == DELETE && ett[i]->has_edge(update.edge.src, update.edge.dst)) {
+			ett[i]->cut(update.edge.src, update.edge.dst);
 			ENDPOINT_CANARY("Cutting Tier " << i << " ETT With", update.edge.src, update.edge.dst);
 		}
-		root_nodes[2*i] = ett[i].update_sketch(update.edge.src, (vec_t)edge);
-		root_nodes[2*i+1] = ett[i].update_sketch(update.edge.dst, (vec_t)edge);
+		SketchUpdateResult result = ett[i]->update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
+		tier_state[i].roots = {result.root1, result.root2};
+		tier_state[i].root_unchanged = result.root_unchanged;
 		ENDPOINT_CANARY("Updating Sketch With", update.edge.src, update.edge.dst);
-	}
-	STOP(sketch_time, su);
+	});
+	STOP(metrics.sketch_time, su);
 	// Refresh the data structure
 	START(ref);
 	refresh(update);
-	STOP(refresh_time, ref);
+	STOP(metrics.refresh_time, ref);
+	count_updates(1);
+}
+
+void GraphTiers::update_batch(const std::vector<GraphUpdate>& updates) {
+	uint32_t first_update = 0;
+	while (first_update < updates.size()) {
+		uint32_t num_updates = std::min<uint32_t>(greedy_window, updates.size() - first_update);
+		if (num_updates == 1) {
+			update(updates[first_update]);
+			greedy_window = 2;
+			first_update++;
+			continue;
+		}
+		uint32_t last_update = first_update + num_updates;
+		uint32_t isolated_update = greedy_check(updates, first_update, last_update);
+		if (isolated_update == last_update) {
+			greedy_window = std::min<uint32_t>(2*greedy_window, MAX_INT);
+			first_update = last_update;
+			continue;
+		}
+		// Resolve the isolated update on its own, the rest of the batch is checked greedily again
+		update(updates[isolated_update]);
+		// Size the next range to the isolation rate so the rolled back suffix stays below the committed prefix
+		greedy_window = std::max<uint32_t>(2*(isolated_update - first_update), 1);
+		first_update = isolated_update + 1;
+	}
+}
+
+uint32_t GraphTiers::greedy_check(const std::vector<GraphUpdate>& updates, uint32_t first_update, uint32_t last_update) {
+	uint32_t num_updates = last_update - first_update;
+	// Do all the dynamic tree cutting for things in the batch
+	dt_split_revert.assign(num_updates, MAX_INT);
+	for (uint32_t i = 0; i < num_updates; i++) {
+		GraphUpdate update = updates[first_update+i];
+		unlikely_if (update.type == DELETE && dynamic_tree.has_edge(update.edge.src, update.edge.dst)) {
+			dt_split_revert[i] = dynamic_tree.get_edge_weight(update.edge.src, update.edge.dst);
+			dt_cut(update.edge.src, update.edge.dst);
+		}
+	}
+	// Speculatively apply the whole batch to every tier in parallel, recording
+	// the sizes and sketch queries of the endpoint trees after each update
+	START(su);
+	pool.for_tiers(0, ett.size(), [&](uint32_t tier) {
+		// The representative also samples the collapsed tiers of its run
+		if (rep[tier] != tier)
+			return;
+		uint32_t run_end = tier+1;
+		while (run_end < ett.size() && rep[run_end] == tier)
+			run_end++;
+		// The top tier is never isolated so its sketches need not be queried
+		uint32_t sample_end = std::min<uint32_t>(run_end, ett.size()-1);
+		std::vector<std::pair<uint32_t, uint32_t>>& batch_sizes = tier_state[tier].batch_sizes;
+		std::vector<bool>& batch_split_revert = tier_state[tier].batch_split_revert;
+		batch_sizes.resize(num_updates);
+		batch_split_revert.assign(num_updates, false);
+		for (uint32_t run_tier = tier; run_tier < sample_end; run_tier++)
+			tier_state[run_tier].batch_query_results.resize(2*num_updates);
+		for (uint32_t i = 0; i < num_updates; i++) {
+			GraphUpdate update = updates[first_update+i];
+			edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
+			unlikely_if (update.type == DELETE && ett[tier]->has_edge(update.edge.src, update.edge.dst)) {
+				ett[tier]->cut(update.edge.src, update.edge.dst);
+				batch_split_revert[i] = true;
+			}
+			SketchUpdateResult roots = ett[tier]->update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
+			batch_sizes[i] = {roots.root1->size, roots.root2->size};
+			for (uint32_t run_tier = tier; run_tier < sample_end; run_tier++) {
+				std::vector<SampleResult>& batch_query_results = tier_state[run_tier].batch_query_results;
+				// An unchanged root keeps the non-isolated status it had before the update
+				if (roots.root_unchanged) {
+					batch_query_results[2*i] = ZERO;
+					batch_query_results[2*i+1] = ZERO;
+					metrics.sketch_samples_skipped++;
+					continue;
+				}
+				Sketch* ett_agg = tier_aggregate(run_tier, roots.root1);
+				ett_agg->reset_sample_state();
+				batch_query_results[2*i] = ett_agg->sample().result;
+				ett_agg = tier_aggregate(run_tier, roots.root2);
+				ett_agg->reset_sample_state();
+				batch_query_results[2*i+1] = ett_agg->sample().result;
+			}
+		}
+	});
+	STOP(metrics.sketch_time, su);
+	// Find the first update in the batch that isolates a tree on any tier
+	START(iso);
+	pool.for_tiers(0, ett.size()-1, [&](uint32_t tier) {
+		// Collapsed tiers read the sizes of their representatives
+		TierState& rep_state = tier_state[rep[tier]];
+		TierState& next_state = tier_state[rep[tier+1]];
+		std::vector<SampleResult>& batch_query_results = tier_state[tier].batch_query_results;
+		tier_state[tier].isolated_update = MAX_INT;
+		for (uint32_t i = 0; i < num_updates; i++) {
+			if ((rep_state.batch_sizes[i].first == next_state.batch_sizes[i].first && batch_query_results[2*i] == GOOD)
+			    || (rep_state.batch_sizes[i].second == next_state.batch_sizes[i].second && batch_query_results[2*i+1] == GOOD)) {
+				tier_state[tier].isolated_update = i;
+				break;
+			}
+		}
+	});
+	uint32_t isolated_update = MAX_INT;
+	for (uint32_t tier = 0; tier < ett.size()-1; tier++)
+		isolated_update = std::min(isolated_update, tier_state[tier].isolated_update);
+	STOP(metrics.parallel_isolated_check, iso);
+	if (isolated_update == MAX_INT) {
+		count_updates(num_updates);
+		return last_update;
+	}
+	// Undo the isolated update and everything after it on all tiers
+	START(rb);
+	pool.for_tiers(0, ett.size(), [&](uint32_t tier) {
+		if (rep[tier] != tier)
+			return;
+		for (uint32_t i = isolated_update; i < num_updates; i++) {
+			GraphUpdate update = updates[first_update+i];
+			edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
+			// There could be a cut on a later update that needs to be rolled back
+			unlikely_if (tier_state[tier].batch_split_revert[i])
+				ett[tier]->link(update.edge.src, update.edge.dst);
+			ett[tier]->update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
+		}
+	});
+	for (uint32_t i = isolated_update; i < num_updates; i++) {
+		unlikely_if (dt_split_revert[i] != MAX_INT)
+			dt_link(updates[first_update+i].edge.src, updates[first_update+i].edge.dst, dt_split_revert[i]);
+	}
+	STOP(metrics.sketch_time, rb);
+	count_updates(isolated_update);
+	return first_update + isolated_update;
 }
 
 void GraphTiers::refresh(GraphUpdate update) {
-	// In parallel check if all tiers are not isolated
+	// In parallel check if all tiers are not isolated, stopping once any tier is
 	START(iso);
 	std::atomic<bool> isolated(false);
-	//#pragma omp parallel for
-	for (uint32_t tier = 0; tier < ett.size()-1; tier++) {
-		// Check if the tree containing first endpoint is isolated
-		uint32_t tier_size1 = root_nodes[2*tier]->size;
-		uint32_t next_size1 = root_nodes[2*(tier+1)]->size;
-		if (tier_size1 == next_size1) {
-			root_nodes[2*tier]->process_updates();
-			Sketch* ett_agg1 = root_nodes[2*tier]->sketch_agg;
-			ett_agg1->reset_sample_state();
-			SketchSample query_result1 = ett_agg1->sample();
-			if (query_result1.result == GOOD) {
-				isolated = true;
-				continue;
-			}
+	pool.for_tiers(0, ett.size()-1, [&](uint32_t tier) {
+		// Collapsed tiers are checked by their representative
+		if (rep[tier] != tier)
+			return;
+		// An unchanged root keeps the non-isolated status it had before the update
+		if (tier_state[tier].root_unchanged) {
+			metrics.sketch_samples_skipped++;
+			return;
 		}
-		// Check if the tree containing second endpoint is isolated
-		uint32_t tier_size2 = root_nodes[2*tier+1]->size;
-		uint32_t next_size2 = root_nodes[2*(tier+1)+1]->size;
-		if (tier_size2 == next_size2) {
-			root_nodes[2*tier+1]->process_updates();
-			Sketch* ett_agg2 = root_nodes[2*tier+1]->sketch_agg;
-			ett_agg2->reset_sample_state();
-			SketchSample query_result2 = ett_agg2->sample();
-			if (query_result2.result == GOOD) {
-				isolated = true;
-				continue;
+		for (uint32_t run_tier = tier; run_tier < ett.size()-1 && rep[run_tier] == tier; run_tier++) {
+			for (int endpoint : {0,1}) {
+				if (isolated.load(std::memory_order_relaxed)) {
+					metrics.isolated_check_skipped += 2-endpoint;
+					return;
+				}
+				// Check if the tree containing this endpoint is isolated
+				SkipListNode* root = endpoint ? tier_state[tier].roots.second : tier_state[tier].roots.first;
+				TierState& next_state = tier_state[rep[run_tier+1]];
+				SkipListNode* next_root = endpoint ? next_state.roots.second : next_state.roots.first;
+				if (root->size != next_root->size)
+					continue;
+				Sketch* ett_agg = tier_aggregate(run_tier, root);
+				ett_agg->reset_sample_state();
+				if (ett_agg->sample().result == GOOD) {
+					isolated = true;
+					return;
+				}
 			}
 		}
-	}
-	STOP(parallel_isolated_check, iso);
-	if (!isolated)
+	});
+	STOP(metrics.parallel_isolated_check, iso);
+	if (!isolated) {
+		metrics.updates_without_refresh++;
 		return;
-	normal_refreshes++;
+	}
+	metrics.normal_refreshes++;
 	// For each tier for each endpoint of the edge
 	for (uint32_t tier = 0; tier < ett.size()-1; tier++) {
 		for (node_id_t v : {update.edge.src, update.edge.dst}) {
 			// Check if the tree containing this endpoint is isolated
 			START(size);
-			uint32_t tier_size = ett[tier].get_size(v);
-			uint32_t next_size = ett[tier+1].get_size(v);
-			STOP(ett_find_root, size);
+			uint32_t tier_size = ett[rep[tier]]->get_size(v);
+			uint32_t next_size = ett[rep[tier+1]]->get_size(v);
+			STOP(metrics.ett_find_root, size);
 			// Check for same size for isolated
 			if (tier_size != next_size)
 				continue;
 
-			START(agg);
-			SkipListNode* root = ett[tier].get_root(v);
-			root->process_updates();
-			Sketch* ett_agg = root->sketch_agg;
-			STOP(ett_get_agg, agg);
 			START(sq);
-			ett_agg->reset_sample_state();
-			SketchSample query_result = ett_agg->sample();
-			STOP(sketch_query, sq);
+			SketchSample query_result = sample_tier(tier, v);
+			STOP(metrics.sketch_query, sq);
 
 			// Check for new edge to eliminate isolation
 			if (query_result.result != GOOD)
 				continue;
 
-			tiers_grown++;
+			metrics.tiers_grown++;
 			edge_id_t edge = query_result.idx;
 			node_id_t a = (node_id_t)edge;
 			node_id_t b = (node_id_t)(edge>>32);
 
 			// Check if a path exists between the edge's endpoints
 			START(lct1);
-			void* a_root = link_cut_tree.find_root(a);
-			void* b_root = link_cut_tree.find_root(b);
-			STOP(lct_time, lct1);
-			if (a_root == b_root) {
-				START(lct2);
-				// Find the maximum tier edge on the path and what tier it first appeared on
-				std::pair<edge_id_t, uint32_t> max = link_cut_tree.path_aggregate(a,b);
-				node_id_t c = (node_id_t)max.first;
-				node_id_t d = (node_id_t)(max.first>>32);
-				STOP(lct_time, lct2);
+			PathMaxResult max = dynamic_tree.connected_path_max(a, b);
+			STOP(metrics.lct_time, lct1);
+			if (max.connected) {
+				// The maximum tier edge on the path and what tier it first appeared on
+				node_id_t c = (node_id_t)max.max_edge;
+				node_id_t d = (node_id_t)(max.max_edge>>32);
 
 				// Remove the maximum tier edge on all paths where it exists
 				START(ett1);
-				#pragma omp parallel for
-				for (uint32_t i = max.second; i < ett.size(); i++) {
-					ett[i].cut(c,d);
+				pool.for_tiers(max.weight, ett.size(), [&](uint32_t i) {
+					if (rep[i] != i) return;
+					ett[i]->cut(c,d);
 					ENDPOINT_CANARY("Cutting Tier " << i << " ETT With", c, d);
-				}
-				STOP(ett_time, ett1);
+				});
+				STOP(metrics.ett_time, ett1);
 				START(lct3);
-				link_cut_tree.cut(c,d);
-				STOP(lct_time, lct3);
+				dt_cut(c,d);
+				STOP(metrics.lct_time, lct3);
 			}
 
 			// Join the ETTs for the endpoints of the edge on all tiers above the current
 			START(ett2);
-			#pragma omp parallel for
-			for (uint32_t i = tier+1; i < ett.size(); i++) {
-				ett[i].link(a,b);
+			// The tiers below stop being identical to the ones linked here
+			materialize_tier(tier+1);
+			pool.for_tiers(tier+1, ett.size(), [&](uint32_t i) {
+				if (rep[i] != i) return;
+				ett[i]->link(a,b);
 				ENDPOINT_CANARY("Linking Tier " << i << " ETT With", a, b);
-			}
-			STOP(ett_time, ett2);
+			});
+			STOP(metrics.ett_time, ett2);
 			START(lct4);
-			link_cut_tree.link(a,b, tier+1);
-			STOP(lct_time, lct4);
+			dt_link(a,b, tier+1);
+			STOP(metrics.lct_time, lct4);
 		}
 	}
 }
@@ -179,10 +396,10 @@ void GraphTiers::refresh(GraphUpdate update) {
 std::vector<std::set<node_id_t>> GraphTiers::get_cc() {
 	std::vector<std::set<node_id_t>> cc;
 	std::set<EulerTourNode*> visited;
-	int top = ett.size()-1;
-	for (uint32_t i = 0; i < ett[top].ett_nodes.size(); i++) {
-		if (visited.find(&ett[top].ett_nodes[i]) == visited.end()) {
-			std::set<EulerTourNode*> pointer_component = ett[top].ett_nodes[i].get_component();
+	EulerTourTree& top = *ett[rep[ett.size()-1]];
+	for (uint32_t i = 0; i < top.ett_nodes.size(); i++) {
+		if (visited.find(&top.ett_nodes[i]) == visited.end()) {
+			std::set<EulerTourNode*> pointer_component = top.ett_nodes[i].get_component();
 			std::set<node_id_t> component;
 			for (auto pointer : pointer_component) {
 				component.insert(pointer->vertex);
@@ -195,5 +412,5 @@ std::vector<std::set<node_id_t>> GraphTiers::get_cc() {
 }
 
 bool GraphTiers::is_connected(node_id_t a, node_id_t b) {
-	return this->link_cut_tree.find_root(a) == this->link_cut_tree.find_root(b);
+	return this->dynamic_tree.connected_path_max(a, b).connected;
 }
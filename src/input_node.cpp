@@ -1,33 +1,64 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
 #include "../include/mpi_nodes.h"
 
 
 long normal_refreshes = 0;
 long dt_operation_time = 0;
 
-InputNode::InputNode(node_id_t num_nodes, uint32_t num_tiers, int batch_size, int seed) :
-    num_nodes(num_nodes), num_tiers(num_tiers), link_cut_tree(num_nodes), query_ett(num_nodes, 0, seed) {
-    update_buffer = (UpdateMessage*) malloc(sizeof(UpdateMessage)*(batch_size+1));
+// Shrink the adaptive batch size when a greedy check commits less than this fraction of a batch
+#define ADAPTIVE_SHRINK_COMMIT_FRACTION 0.25
+// Grow it when at most this fraction of the updates of a batch needed a refresh
+#define ADAPTIVE_GROW_ISOLATION_FRACTION 0.01
+// A batch whose throughput falls below this fraction of the last one is too large
+#define ADAPTIVE_THROUGHPUT_TOLERANCE 0.9
+
+InputNode::InputNode(node_id_t num_nodes, uint32_t num_tiers, int batch_size, int seed, const GraphConfig& config,
+    const InputNodeOptions& options, Transport& world) :
+    num_nodes(num_nodes), num_tiers(num_tiers), world(world), comm(world.split(true)), placement(num_tiers, comm->size()-1),
+    dynamic_tree(num_nodes), query_ett(num_nodes, 0, seed, config), concurrent_refresh(options.concurrent_refresh),
+    replicated_lct(options.replicated_lct), query_node(options.query_node),
+    reorder_batches(options.reorder_batches), adaptive_batches(options.max_batch_size > 0),
+    max_batch_size(std::max(batch_size, options.max_batch_size)) {
+    // Every buffer holds the largest batch, buffer_capacity is the size of the current one
+    int capacity = this->max_batch_size;
+    update_buffer = (GraphUpdate*) malloc(sizeof(GraphUpdate)*(capacity+1));
     buffer_capacity = batch_size+1;
-    UpdateMessage msg;
-    update_buffer[0] = msg;
     buffer_size = 1;
-    split_revert_buffer = (int*) malloc(sizeof(int)*batch_size);
+    split_revert_buffer = (int*) malloc(sizeof(int)*capacity);
     history_size = 2*batch_size;
     for (int i=0; i<history_size; i++)
         isolation_history_queue.push(true);
     isolation_count = history_size;
+    component_labels.resize(capacity+1);
+    isolated_bitmap.resize((capacity+31)/32);
+    refresh_selection.resize(capacity+2);
+    batch_comm = comm->dup();
+    // The tier nodes split off the chain of tier ranks for the size exchange of the greedy check
+    comm->split(false);
+    batch_payload = (uint8_t*) malloc(max_payload_bytes(capacity));
+    // The query node is the one rank of the world outside the tier protocol
+    query_rank = world.size()-1;
+    assert(!query_node || comm->size() == query_rank);
 };
 
 InputNode::~InputNode() {
+    batch_comm->wait(batch_requests[0]);
+    batch_comm->wait(batch_requests[1]);
+    free(batch_payload);
+    for (auto& send : query_sends)
+        world.wait(send.first);
     free(update_buffer);
     free(split_revert_buffer);
 }
 
 void InputNode::update(GraphUpdate update) {
-    UpdateMessage update_message;
-    update_message.update = update;
-    update_buffer[buffer_size++] = update_message;
-    if (buffer_size == buffer_capacity)
+    update_buffer[buffer_size++] = update;
+    if (buffer_size >= buffer_capacity)
         process_updates();
 }
 
@@ -35,125 +66,360 @@ void InputNode::process_updates() {
     if (buffer_size == 1)
         return;
     uint32_t num_updates = buffer_size-1;
+    auto batch_start = std::chrono::steady_clock::now();
+    long refreshes_before = normal_refreshes;
+    // Updates committed by the greedy checks that stopped at an isolated update
+    uint64_t committed_prefixes = 0;
+    uint32_t num_isolating_rounds = 0;
     // If less than 1/10 of the last updates are isolated use sliding window
     bool prev_strat = using_sliding_window;
     using_sliding_window = false;//(isolation_count<history_size/10) ? true : false;
     if (using_sliding_window != prev_strat)
         std::cout << "SWITCHED TO " << (using_sliding_window ? "SLIDING WINDOW" : "NORMAL STRAT") << std::endl;
+    if (reorder_batches)
+        reorder_batch(&update_buffer[1], num_updates, dynamic_tree);
     // Broadcast the batch of updates to all nodes
-    update_buffer[0].update.edge.src = num_updates;
-    update_buffer[0].update.edge.dst = (int)using_sliding_window;
-    bcast(&update_buffer[0], sizeof(UpdateMessage)*buffer_capacity, 0);
-    // Do all the link cut tree cutting for things in the batch
-    for (uint32_t i = 0; i < num_updates; i++) {
-        GraphUpdate update = update_buffer[i+1].update;
-        split_revert_buffer[i] = MAX_INT;
-        unlikely_if (update.type == DELETE && link_cut_tree.has_edge(update.edge.src, update.edge.dst)) {
-            split_revert_buffer[i] = link_cut_tree.get_edge_weight(update.edge.src, update.edge.dst);
-            link_cut_tree.cut(update.edge.src, update.edge.dst);
-            query_ett.cut(update.edge.src, update.edge.dst);
+    batch_concurrent_refresh = concurrent_refresh && !using_sliding_window;
+    uint8_t flags = 0;
+    if (using_sliding_window)
+        flags |= BATCH_SLIDING_WINDOW;
+    if (batch_concurrent_refresh)
+        flags |= BATCH_CONCURRENT_REFRESH;
+    if (replicated_lct)
+        flags |= BATCH_REPLICATED_LCT;
+    broadcast_batch(num_updates, flags);
+    // Greedily check the batch, then resolve the first isolated update and check the rest again
+    uint32_t first_update = 1;
+    while (first_update <= num_updates) {
+        if (batch_concurrent_refresh)
+            label_components(first_update, num_updates);
+        // Do all the link cut tree cutting for things in the rest of the batch
+        for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++) {
+            GraphUpdate update = update_buffer[update_idx];
+            split_revert_buffer[update_idx-1] = MAX_INT;
+            unlikely_if (update.type == DELETE && dynamic_tree.has_edge(update.edge.src, update.edge.dst)) {
+                split_revert_buffer[update_idx-1] = dynamic_tree.get_edge_weight(update.edge.src, update.edge.dst);
+                dynamic_tree.cut(update.edge.src, update.edge.dst);
+                cut_query_forest(update.edge.src, update.edge.dst);
+            }
         }
+        if (batch_concurrent_refresh) {
+            // Gather every isolated update and resolve the independent ones in one round
+            std::vector<uint32_t> no_isolated(isolated_bitmap.size(), 0);
+            comm->reduce_bitwise_or(no_isolated.data(), isolated_bitmap.data(), isolated_bitmap.size(), 0);
+            select_refreshes(first_update, num_updates);
+            comm->bcast(refresh_selection.data(), sizeof(uint32_t)*refresh_selection.size(), 0);
+            uint32_t next_update = refresh_selection[0];
+            uint32_t num_refreshes = refresh_selection[1];
+            if (num_refreshes == 0)
+                break;
+            committed_prefixes += refresh_selection[2] - first_update;
+            num_isolating_rounds++;
+            for (uint32_t update_idx = next_update; update_idx < num_updates+1; update_idx++) {
+                GraphUpdate update = update_buffer[update_idx];
+                unlikely_if (split_revert_buffer[update_idx-1] != MAX_INT) {
+                    dynamic_tree.link(update.edge.src, update.edge.dst, split_revert_buffer[update_idx-1]);
+                    link_query_forest(update.edge.src, update.edge.dst);
+                }
+            }
+            refresh_updates(&refresh_selection[2], num_refreshes);
+            first_update = next_update;
+            continue;
+        }
+        // Attempt to do the rest of the batch parallel with greedy refresh
+        int minimum_isolated_update = comm->allreduce_min(MAX_INT);
+        // Check for any isolation on any update on any tier
+        if (minimum_isolated_update == MAX_INT)
+            break;
+        committed_prefixes += minimum_isolated_update - first_update;
+        num_isolating_rounds++;
+        // Undo the link cut tree cuts we did after the isolated update, its own cut is kept
+        for (uint32_t update_idx = minimum_isolated_update+1; update_idx < num_updates+1; update_idx++) {
+            GraphUpdate update = update_buffer[update_idx];
+            // There could be a cut on a later update that needs to be rolled back
+            unlikely_if (split_revert_buffer[update_idx-1] != MAX_INT) {
+                dynamic_tree.link(update.edge.src, update.edge.dst, split_revert_buffer[update_idx-1]);
+                link_query_forest(update.edge.src, update.edge.dst);
+            }
+        }
+        // Update the isolation history
+        for (uint32_t i = first_update; i < (uint32_t)minimum_isolated_update; i++) {
+            isolation_count -= (int)isolation_history_queue.front();
+            isolation_history_queue.pop();
+            isolation_history_queue.push(true);
+        }
+        refresh_update(minimum_isolated_update);
+        // Shift the rest of the updates to the beginning of the buffer
+        if (using_sliding_window) {
+            for (int i = 0; i < buffer_size-minimum_isolated_update-1; i++)
+                update_buffer[i+1] = update_buffer[minimum_isolated_update+i+1];
+            buffer_size = buffer_size-minimum_isolated_update;
+            send_forest_changes();
+            return;
+        }
+        first_update = minimum_isolated_update+1;
     }
-    // Attempt to do the entire batch parallel with greedy refresh
-    int isolated_update = MAX_INT;
-    int minimum_isolated_update;
-    allreduce(&isolated_update, &minimum_isolated_update);
-    // Check for any isolation on any update on any tier
-    if (minimum_isolated_update == MAX_INT) {
-        buffer_size = 1;
-        return;
+    buffer_size = 1;
+    send_forest_changes();
+    if (adaptive_batches) {
+        long batch_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch_start).count();
+        uint32_t commit_length = num_isolating_rounds ? committed_prefixes / num_isolating_rounds : num_updates;
+        adapt_batch_size(num_updates, commit_length, normal_refreshes - refreshes_before, batch_time);
     }
-    // First undo all the link cut tree cuts we did after isolated update
-    for (uint32_t update_idx = minimum_isolated_update; update_idx < num_updates+1; update_idx++) {
-        GraphUpdate update = update_buffer[update_idx].update;
-        // There could be a cut on a later update that needs to be rolled back
-        unlikely_if (split_revert_buffer[update_idx-1] != MAX_INT) {
-            link_cut_tree.link(update.edge.src, update.edge.dst, split_revert_buffer[update_idx-1]);
-            query_ett.link(update.edge.src, update.edge.dst);
+}
+
+void InputNode::adapt_batch_size(uint32_t num_updates, uint32_t commit_length, long num_refreshes, long batch_time) {
+    int batch_size = buffer_capacity-1;
+    // Queries flush partial batches, only full ones say anything about the batch size
+    if ((int)num_updates != batch_size)
+        return;
+    double throughput = (double)num_updates / std::max(batch_time, 1L);
+    if (commit_length < ADAPTIVE_SHRINK_COMMIT_FRACTION*num_updates)
+        batch_size = std::max(2*commit_length, 1u);
+    else if (num_refreshes <= ADAPTIVE_GROW_ISOLATION_FRACTION*num_updates
+            && throughput >= ADAPTIVE_THROUGHPUT_TOLERANCE*last_throughput)
+        batch_size = std::min(2*batch_size, max_batch_size);
+    else if (throughput < ADAPTIVE_THROUGHPUT_TOLERANCE*last_throughput)
+        batch_size = std::max(3*batch_size/4, 1);
+    last_throughput = throughput;
+    buffer_capacity = batch_size+1;
+}
+
+void InputNode::broadcast_batch(uint32_t num_updates, uint8_t flags) {
+    // The last broadcast finished long ago, every tier node answered the batch since, but
+    // the request still has to be completed before the buffer is encoded into again
+    batch_comm->wait(batch_requests[0]);
+    batch_comm->wait(batch_requests[1]);
+    batch_header = BatchHeader();
+    batch_header.flags = flags;
+    batch_header.num_updates = num_updates;
+    batch_header.payload_bytes = encode_updates(&update_buffer[1], num_updates, batch_payload, batch_header.flags);
+    // The tier nodes learn the size of the payload from the header
+    batch_requests[0] = batch_comm->ibcast(&batch_header, sizeof(BatchHeader), 0);
+    if (!(flags & BATCH_END))
+        batch_requests[1] = batch_comm->ibcast(batch_payload, batch_header.payload_bytes, 0);
+}
+
+void InputNode::refresh_update(uint32_t update_idx) {
+    GraphUpdate update = update_buffer[update_idx];
+    uint32_t start_tier = 0;
+    normal_refreshes++;
+    bool this_update_isolated = false;
+    // Initiate the refresh sequence and receive all the broadcasts
+    RefreshEndpoint e1, e2;
+    e1.v = update.edge.src;
+    e2.v = update.edge.dst;
+    RefreshMessage refresh_message;
+    refresh_message.endpoints = {e1, e2};
+    comm->send(&refresh_message, sizeof(RefreshMessage), placement.rank_of(start_tier), 0);
+    for (uint32_t tier = start_tier; tier < num_tiers; tier++) {
+        int rank = placement.rank_of(tier);
+        if (tier != 0)
+        for (auto endpoint : {0,1}) {
+            std::ignore = endpoint;
+            // Receive a broadcast to see if the current tier/endpoint is isolated or not
+            EttUpdateMessage update_message;
+            comm->bcast(&update_message, sizeof(EttUpdateMessage), rank);
+            if (update_message.type == NOT_ISOLATED)
+                continue;
+            this_update_isolated = true;
+            // Process a LCT query message first
+            if (!replicated_lct) {
+                LctResponseMessage response_message;
+                PathMaxResult max = dynamic_tree.connected_path_max(update_message.endpoint1, update_message.endpoint2);
+                response_message.connected = max.connected;
+                response_message.cycle_edge = max.max_edge;
+                response_message.weight = max.weight;
+                comm->send(&response_message, sizeof(LctResponseMessage), rank, 0);
+            }
+
+            // Then process the cut and link of the refresh step in the LCT
+            EttRefreshStepMessage step_message;
+            comm->bcast(&step_message, sizeof(EttRefreshStepMessage), rank);
+            START(dt_operation_timer2);
+            apply_refresh_step(step_message);
+            STOP(dt_operation_time, dt_operation_timer2);
         }
     }
-    // Update the isolation history
-    for (uint32_t i = 1; i < minimum_isolated_update; i++) {
-        isolation_count -= (int)isolation_history_queue.front();
-        isolation_history_queue.pop();
+    isolation_count -= (int)isolation_history_queue.front();
+    isolation_history_queue.pop();
+    if (this_update_isolated) {
         isolation_history_queue.push(true);
+        isolation_count += 1;
+    } else
+        isolation_history_queue.push(false);
+}
+
+void InputNode::apply_refresh_step(EttRefreshStepMessage message) {
+    if (message.cut.type == CUT) {
+        dynamic_tree.cut(message.cut.endpoint1, message.cut.endpoint2);
+        cut_query_forest(message.cut.endpoint1, message.cut.endpoint2);
     }
-    // ======================================================================================
-    // =========================== PROCESS THE ISOLATED UPDATES =============================
-    // ======================================================================================
-    int end_update_idx = using_sliding_window ? minimum_isolated_update+1 : num_updates+1;
-    for (int update_idx = minimum_isolated_update; update_idx < end_update_idx; update_idx++) {
-        GraphUpdate update = update_buffer[update_idx].update;
-        START(dt_operation_timer1);
-        unlikely_if (update.type == DELETE && link_cut_tree.has_edge(update.edge.src, update.edge.dst)) {
-            link_cut_tree.cut(update.edge.src, update.edge.dst);
-            query_ett.cut(update.edge.src, update.edge.dst);
+    if (message.link.type == LINK) {
+        dynamic_tree.link(message.link.endpoint1, message.link.endpoint2, message.link.start_tier);
+        link_query_forest(message.link.endpoint1, message.link.endpoint2);
+    }
+}
+
+void InputNode::cut_query_forest(node_id_t a, node_id_t b) {
+    query_ett.cut(a, b);
+    if (query_node)
+        forest_changes[VERTICES_TO_EDGE(a, b)]--;
+}
+
+void InputNode::link_query_forest(node_id_t a, node_id_t b) {
+    query_ett.link(a, b);
+    if (query_node)
+        forest_changes[VERTICES_TO_EDGE(a, b)]++;
+}
+
+void InputNode::send_to_query_node(QueryNodeMessage message, const EttUpdateMessage* changes) {
+    // Sends complete in order, drop the buffers of the finished ones
+    while (!query_sends.empty() && world.test(query_sends.front().first))
+        query_sends.pop_front();
+    query_sends.emplace_back();
+    std::vector<uint8_t>& buffer = query_sends.back().second;
+    buffer.resize(sizeof(QueryNodeMessage) + sizeof(EttUpdateMessage)*message.num_changes);
+    memcpy(buffer.data(), &message, sizeof(QueryNodeMessage));
+    if (message.num_changes > 0)
+        memcpy(buffer.data()+sizeof(QueryNodeMessage), changes, sizeof(EttUpdateMessage)*message.num_changes);
+    query_sends.back().first = world.isend(buffer.data(), buffer.size(), query_rank, QUERY_NODE_TAG);
+}
+
+void InputNode::send_forest_changes() {
+    if (!query_node)
+        return;
+    // Speculative cuts are mostly undone within the batch, only the net change of each edge is sent.
+    // The cuts go first so every link joins two trees of the forest
+    std::vector<EttUpdateMessage> changes;
+    for (int type : {CUT, LINK}) {
+        for (auto& change : forest_changes) {
+            if (change.second == 0 || (change.second < 0) != (type == CUT))
+                continue;
+            EttUpdateMessage message;
+            message.type = (TreeOperationType)type;
+            message.endpoint1 = change.first >> 32;
+            message.endpoint2 = (node_id_t)change.first;
+            changes.push_back(message);
         }
-        STOP(dt_operation_time, dt_operation_timer1);
-        uint32_t start_tier = 0;
-        normal_refreshes++;
-        bool this_update_isolated = false;
-        // Initiate the refresh sequence and receive all the broadcasts
-        RefreshEndpoint e1, e2;
-        e1.v = update.edge.src;
-        e2.v = update.edge.dst;
-        RefreshMessage refresh_message;
-        refresh_message.endpoints = {e1, e2};
-        MPI_Send(&refresh_message, sizeof(RefreshMessage), MPI_BYTE, start_tier+1, 0, MPI_COMM_WORLD);
-        for (uint32_t tier = start_tier; tier < num_tiers; tier++) {
-            int rank = tier + 1;
-            if (tier != 0)
-            for (auto endpoint : {0,1}) {
-                std::ignore = endpoint;
-                // Receive a broadcast to see if the current tier/endpoint is isolated or not
-                EttUpdateMessage update_message;
-                bcast(&update_message, sizeof(UpdateMessage), rank);
-                if (update_message.type == NOT_ISOLATED)
+    }
+    forest_changes.clear();
+    if (changes.empty())
+        return;
+    QueryNodeMessage message;
+    message.type = FOREST_CHANGES;
+    message.num_changes = changes.size();
+    send_to_query_node(message, changes.data());
+}
+
+std::vector<node_id_t> InputNode::receive_answer(uint32_t query) {
+    assert(query_node && query < queries_sent);
+    // The query node answers in order, keep the earlier answers until they are asked for
+    while (answers_received <= query) {
+        int count = world.probe(query_rank, QUERY_ANSWER_TAG);
+        std::vector<node_id_t>& answer = answers[answers_received++];
+        answer.resize(count/sizeof(node_id_t));
+        world.recv(answer.data(), count, query_rank, QUERY_ANSWER_TAG);
+    }
+    auto it = answers.find(query);
+    assert(it != answers.end());
+    std::vector<node_id_t> answer = std::move(it->second);
+    answers.erase(it);
+    return answer;
+}
+
+void InputNode::label_components(uint32_t first_update, uint32_t num_updates) {
+    // A refresh only links and cuts edges within the component of the graph containing its update.
+    // Before the speculative cuts the query forest spans the components of the graph without the
+    // rest of the batch, which can only merge them through its insertions
+    std::unordered_map<void*, uint32_t> tree_ids;
+    std::vector<uint32_t> parent;
+    auto tree_id = [&](node_id_t v) {
+        SketchlessSkipListNode* root = query_ett.get_root(v);
+        void* key = root ? (void*)root : (void*)&query_ett.ett_nodes[v];
+        auto it = tree_ids.find(key);
+        if (it != tree_ids.end())
+            return it->second;
+        parent.push_back(parent.size());
+        return tree_ids[key] = parent.size()-1;
+    };
+    auto find = [&](uint32_t x) {
+        while (parent[x] != x)
+            x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++) {
+        GraphUpdate update = update_buffer[update_idx];
+        uint32_t a = tree_id(update.edge.src);
+        uint32_t b = tree_id(update.edge.dst);
+        component_labels[update_idx] = a;
+        parent[find(a)] = find(b);
+    }
+    for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++)
+        component_labels[update_idx] = find(component_labels[update_idx]);
+}
+
+void InputNode::select_refreshes(uint32_t first_update, uint32_t num_updates) {
+    refresh_selection[0] = num_updates+1;
+    refresh_selection[1] = 0;
+    // Isolation history is not kept since the sliding window is never used with concurrent refreshes
+    std::vector<uint32_t> claimed;
+    for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++) {
+        uint32_t i = update_idx-1;
+        uint32_t label = component_labels[update_idx];
+        bool isolated = isolated_bitmap[i/32] & (1u << (i%32));
+        if (std::find(claimed.begin(), claimed.end(), label) != claimed.end()) {
+            // A refresh before this update can change its trees, so it is checked again after the round
+            refresh_selection[0] = update_idx;
+            break;
+        }
+        if (isolated) {
+            refresh_selection[2+refresh_selection[1]++] = update_idx;
+            claimed.push_back(label);
+        }
+    }
+}
+
+void InputNode::refresh_updates(uint32_t* update_idxs, uint32_t num_refreshes) {
+    std::vector<RefreshMessage> refresh_messages(num_refreshes);
+    std::vector<EttUpdateMessage> update_messages(num_refreshes);
+    std::vector<LctResponseMessage> response_messages(num_refreshes);
+    std::vector<EttRefreshStepMessage> step_messages(num_refreshes);
+    normal_refreshes += num_refreshes;
+    // Initiate one refresh sequence for all the updates and receive all the broadcasts
+    for (uint32_t r = 0; r < num_refreshes; r++) {
+        GraphUpdate update = update_buffer[update_idxs[r]];
+        refresh_messages[r].endpoints.first.v = update.edge.src;
+        refresh_messages[r].endpoints.second.v = update.edge.dst;
+    }
+    comm->send(refresh_messages.data(), sizeof(RefreshMessage)*num_refreshes, placement.rank_of(0), 0);
+    for (uint32_t tier = 1; tier < num_tiers; tier++) {
+        int rank = placement.rank_of(tier);
+        for (auto endpoint : {0,1}) {
+            std::ignore = endpoint;
+            comm->bcast(update_messages.data(), sizeof(EttUpdateMessage)*num_refreshes, rank);
+            if (std::none_of(update_messages.begin(), update_messages.end(),
+                    [](EttUpdateMessage& m){return m.type == ISOLATED;}))
+                continue;
+            // The updates are in different trees so their queries do not depend on each other's links
+            for (uint32_t r = 0; r < num_refreshes && !replicated_lct; r++) {
+                if (update_messages[r].type == NOT_ISOLATED)
                     continue;
-                this_update_isolated = true;
-                // Process a LCT query message first
-                LctResponseMessage response_message;
-                response_message.connected = link_cut_tree.find_root(update_message.endpoint1) == link_cut_tree.find_root(update_message.endpoint2);
-                if (response_message.connected) {
-                    std::pair<edge_id_t, uint32_t> max = link_cut_tree.path_aggregate(update_message.endpoint1, update_message.endpoint2);
-                    response_message.cycle_edge = max.first;
-                    response_message.weight = max.second;
-                }
-                MPI_Send(&response_message, sizeof(LctResponseMessage), MPI_BYTE, rank, 0, MPI_COMM_WORLD);
-
-                // Then process two update broadcasts to potentially cut and link in the LCT
-                for (auto broadcast : {0,1}) {
-                    std::ignore = broadcast;
-                    EttUpdateMessage update_message;
-                    bcast(&update_message, sizeof(EttUpdateMessage), rank);
-                    START(dt_operation_timer2);
-                    if (update_message.type == LINK) {
-                        link_cut_tree.link(update_message.endpoint1, update_message.endpoint2, update_message.start_tier);
-                        query_ett.link(update_message.endpoint1, update_message.endpoint2);
-                        break;
-                    } else if (update_message.type == CUT) {
-                        link_cut_tree.cut(update_message.endpoint1, update_message.endpoint2);
-                        query_ett.cut(update_message.endpoint1, update_message.endpoint2);
-                    }
-                    STOP(dt_operation_time, dt_operation_timer2);
-                }
+                PathMaxResult max = dynamic_tree.connected_path_max(update_messages[r].endpoint1, update_messages[r].endpoint2);
+                response_messages[r].connected = max.connected;
+                response_messages[r].cycle_edge = max.max_edge;
+                response_messages[r].weight = max.weight;
             }
+            if (!replicated_lct)
+                comm->send(response_messages.data(), sizeof(LctResponseMessage)*num_refreshes, rank, 0);
+
+            // Then process the cut and link of every refresh step
+            comm->bcast(step_messages.data(), sizeof(EttRefreshStepMessage)*num_refreshes, rank);
+            START(dt_operation_timer2);
+            for (EttRefreshStepMessage& step_message : step_messages)
+                apply_refresh_step(step_message);
+            STOP(dt_operation_time, dt_operation_timer2);
         }
-        isolation_count -= (int)isolation_history_queue.front();
-        isolation_history_queue.pop();
-        if (this_update_isolated) {
-            isolation_history_queue.push(true);
-            isolation_count += 1;
-        } else
-            isolation_history_queue.push(false);
-    }
-    // Shift the rest of the updates to the beginning of the buffer
-    if (using_sliding_window) {
-        for (int i = 0; i < buffer_size-minimum_isolated_update-1; i++)
-            update_buffer[i+1] = update_buffer[minimum_isolated_update+i+1];
-        buffer_size = buffer_size-minimum_isolated_update;
-    } else {
-        buffer_size = 1;
     }
 }
 
@@ -172,11 +438,48 @@ std::vector<std::set<node_id_t>> InputNode::cc_query() {
     return query_ett.cc_query();
 }
 
+uint32_t InputNode::submit_connectivity_query(node_id_t a, node_id_t b) {
+    QueryNodeMessage message;
+    message.type = CONNECTIVITY_QUERY;
+    message.a = a;
+    message.b = b;
+    send_to_query_node(message);
+    return queries_sent++;
+}
+
+uint32_t InputNode::submit_cc_query() {
+    QueryNodeMessage message;
+    message.type = CC_QUERY;
+    send_to_query_node(message);
+    return queries_sent++;
+}
+
+bool InputNode::connectivity_answer(uint32_t query) {
+    return receive_answer(query)[0];
+}
+
+std::vector<std::set<node_id_t>> InputNode::cc_answer(uint32_t query) {
+    // Each component is sent as its size followed by its vertices
+    std::vector<node_id_t> answer = receive_answer(query);
+    std::vector<std::set<node_id_t>> cc;
+    for (size_t i = 0; i < answer.size(); i += answer[i]+1)
+        cc.emplace_back(&answer[i+1], &answer[i+1]+answer[i]);
+    return cc;
+}
+
 void InputNode::end() {
     process_all_updates();
     // Tell all nodes the stream is over
-    update_buffer[0].end = true;
-    bcast(update_buffer, sizeof(UpdateMessage)*buffer_capacity, 0);
+    broadcast_batch(0, BATCH_END);
+    if (query_node) {
+        // Collect the answers never asked for so the query node is not left sending them
+        while (answers_received < queries_sent)
+            receive_answer(answers_received);
+        answers.clear();
+        QueryNodeMessage message;
+        message.type = QUERY_NODE_END;
+        send_to_query_node(message);
+    }
      std::cout << "======================= INPUT NODE ======================" << std::endl;
      std::cout << "Dynamic tree operations time (ms): " << dt_operation_time/1000 << std::endl;
      std::cout << "Normal refreshes: " << normal_refreshes << std::endl;
@@ -5,7 +5,12 @@ void LinkCutNode::set_parent(LinkCutNode* parent) { this->parent = parent; }
 void LinkCutNode::set_dparent(LinkCutNode* dparent) { this->dparent = dparent; }
 void LinkCutNode::set_max(uint32_t weight){ this->max = weight; }
 void LinkCutNode::set_reversed(bool reversed){ this->reversed = reversed; }
-void LinkCutNode::reverse() { this->reversed = !this->reversed; }
+void LinkCutNode::reverse() {
+    this->reversed = !this->reversed;
+    LinkCutNode* temp = this->head;
+    this->head = this->tail;
+    this->tail = temp;
+}
 
 void LinkCutNode::link_left(LinkCutNode* other) {
     this->left = other;
@@ -34,30 +39,6 @@ LinkCutNode* LinkCutNode::get_tail() { return this->tail; }
 std::pair<edge_id_t, uint32_t> LinkCutNode::get_max_edge() { return {this->max_edge, this->max}; }
 bool LinkCutNode::get_reversed() { return this->reversed; }
 
-LinkCutNode* LinkCutNode::recompute_head() {
-    LinkCutNode* curr = this;
-    LinkCutNode* next;
-    bool reversal_state = false;
-    while (curr != nullptr) {
-        reversal_state = reversal_state != curr->reversed;
-        if((next = reversal_state ? curr->right : curr->left) == nullptr) { this->head = curr; }
-        curr = next;
-    }
-    return this->head;
-}
-
-LinkCutNode* LinkCutNode::recompute_tail() {
-    LinkCutNode* curr = this;
-    LinkCutNode* next;
-    bool reversal_state = false;
-    while (curr != nullptr) {
-        reversal_state = reversal_state != curr->reversed;
-        if((next = reversal_state ? curr->left : curr->right) == nullptr) { this->tail = curr; }
-        curr = next;
-    }
-    return this->tail;
-}
-
 // void inorder(LinkCutNode* node, std::vector<LinkCutNode*>& nodes, bool reversal_state) {
 //     if (node != nullptr) {
 //         reversal_state = reversal_state != node->get_reversed();
@@ -85,45 +66,35 @@ LinkCutNode* LinkCutNode::recompute_tail() {
 //     return nodes;
 // }
 
-void LinkCutNode::correct_reversals() {
-    //std::vector<LinkCutNode*> inorder = get_inorder(this);
-    //Get the XOR of all reversed booleans from this node to root
-    bool reversal_state = 0;
-    LinkCutNode* curr = this;
-    while (curr) {
-        reversal_state = reversal_state != curr->reversed;
-        curr = curr->parent;
-    }
-    //Travel back up performing the reversals where needed
-    curr = this;
-    LinkCutNode* prev = nullptr;
-    while (curr) {
-        bool next_reversal_state = reversal_state != curr->reversed;
-        if (reversal_state) {
-            LinkCutNode* temp = curr->left;
-            curr->left = curr->right;
-            curr->right = temp;
-            if (curr->left && curr->left != prev) {
-                curr->left->set_reversed(!curr->left->reversed);
-            }
-            if (curr->right && curr->right != prev) {
-                curr->right->set_reversed(!curr->right->reversed);
-            }
-        }
-        curr->set_reversed(false);
-        reversal_state = next_reversal_state;
-        prev = curr;
-        curr = curr->parent;
-    }
-    //assert(inorder == get_inorder(this));
+void LinkCutNode::push_down() {
+    if (!this->reversed)
+        return;
+    LinkCutNode* temp = this->left;
+    this->left = this->right;
+    this->right = temp;
+    if (this->left) this->left->reverse();
+    if (this->right) this->right->reverse();
+    this->reversed = false;
+}
+
+void LinkCutNode::push_path() {
+    // Collect the access path so reversals can be pushed down starting from the aux root
+    static thread_local std::vector<LinkCutNode*> path;
+    path.clear();
+    for (LinkCutNode* curr = this; curr != nullptr; curr = curr->parent)
+        path.push_back(curr);
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+        (*it)->push_down();
 }
 
-void LinkCutNode::make_preferred_edge(edge_id_t e) {
+void LinkCutNode::make_preferred_edge(edge_id_t e, uint32_t weight) {
     assert(this->preferred_edges.first == MAX_UINT64 || this->preferred_edges.second == MAX_UINT64);
     if (this->preferred_edges.first == MAX_UINT64) {
         this->preferred_edges.first = e;
+        this->preferred_weights.first = weight;
     } else {
         this->preferred_edges.second = e;
+        this->preferred_weights.second = weight;
     }
 }
 
@@ -131,39 +102,36 @@ void LinkCutNode::unmake_preferred_edge(edge_id_t e) {
     assert(this->preferred_edges.first == e || this->preferred_edges.second == e);
     if (this->preferred_edges.first == e) {
         this->preferred_edges.first = MAX_UINT64;
+        this->preferred_weights.first = 0;
     } else {
         this->preferred_edges.second = MAX_UINT64;
+        this->preferred_weights.second = 0;
     }
 }
 
-void LinkCutNode::insert_edge(edge_id_t e, uint32_t weight) {
-    assert(this->edges.count(e) == 0);
-    this->edges.insert({e, weight});
-}
-
 void LinkCutNode::remove_edge(edge_id_t e) {
-    assert(this->edges.count(e) == 1);
-    this->edges.erase(e);
-}
-
-bool LinkCutNode::has_edge(edge_id_t e) {
-    return (this->edges.find(e) != this->edges.end());
-}
-
-uint32_t LinkCutNode::get_edge_weight(edge_id_t e) {
-    return this->edges[e];
+    if (this->preferred_edges.first == e) {
+        this->preferred_weights.first = 0;
+    } else if (this->preferred_edges.second == e) {
+        this->preferred_weights.second = 0;
+    }
 }
 
 void LinkCutNode::rebuild_max() {
+    // Children must be in their final order before reading their head and tail
+    this->push_down();
+    this->head = this->left ? this->left->head : this;
+    this->tail = this->right ? this->right->tail : this;
+
     uint32_t max = 0;
     edge_id_t max_edge = 0;
 
-    if (this->preferred_edges.first != MAX_UINT64 && this->edges.find(this->preferred_edges.first) != this->edges.end() && this->edges[this->preferred_edges.first] > max) {
-        max = this->edges[this->preferred_edges.first];
+    if (this->preferred_weights.first > max) {
+        max = this->preferred_weights.first;
         max_edge = this->preferred_edges.first;
     }
-    if (this->preferred_edges.second != MAX_UINT64 && this->edges.find(this->preferred_edges.second) != this->edges.end() && this->edges[this->preferred_edges.second] > max) {
-        max = this->edges[this->preferred_edges.second];
+    if (this->preferred_weights.second > max) {
+        max = this->preferred_weights.second;
         max_edge = this->preferred_edges.second;
     }
     if (this->left && this->left->max > max) {
@@ -203,7 +171,7 @@ void LinkCutNode::rotate_up() {
 }
 
 LinkCutNode* LinkCutNode::splay() {
-    this->correct_reversals();
+    this->push_path();
 
     while (this->parent != nullptr) {
         LinkCutNode* parent = this->parent;
@@ -221,8 +189,6 @@ LinkCutNode* LinkCutNode::splay() {
             this->rotate_up();
         }
     }
-    this->recompute_head();
-    this->recompute_tail();
     this->rebuild_max();
     assert(this->get_parent() == nullptr);
     return this;
@@ -237,14 +203,15 @@ LinkCutNode* LinkCutTree::join(LinkCutNode* v, LinkCutNode* w) {
     node_id_t tail_id = tail-&(this->nodes[0]);
     node_id_t head_id = head-&(this->nodes[0]);
     edge_id_t edge = (tail_id < head_id) ? (((edge_id_t)tail_id << 32) + head_id) : (((edge_id_t)head_id << 32) + tail_id);
-    tail->make_preferred_edge(edge);
-    head->make_preferred_edge(edge);
+    // An edge that was just cut is no longer in the table and contributes no weight
+    auto it = this->edge_weights.find(edge);
+    uint32_t weight = (it == this->edge_weights.end()) ? 0 : it->second;
+    tail->make_preferred_edge(edge, weight);
+    head->make_preferred_edge(edge, weight);
     tail->splay();
     head->splay(); // To recompute the aggregate
     assert(tail->get_right() == nullptr);
     tail->link_right(head);
-    tail->recompute_head();
-    tail->recompute_tail();
     return tail;
 }
 
@@ -254,7 +221,7 @@ std::pair<LinkCutNode*, LinkCutNode*> LinkCutTree::split(LinkCutNode* v) {
     LinkCutNode* r = v->get_right();
     LinkCutNode* w = nullptr;
     if (r != nullptr) {
-        w = r->recompute_head();
+        w = r->get_head();
         node_id_t v_id = v-&(this->nodes[0]);
         node_id_t w_id = w-&(this->nodes[0]);
         edge_id_t edge = (v_id < w_id) ? (((edge_id_t)v_id << 32) + w_id) : (((edge_id_t)w_id << 32) + v_id);
@@ -264,11 +231,7 @@ std::pair<LinkCutNode*, LinkCutNode*> LinkCutTree::split(LinkCutNode* v) {
         r->set_parent(nullptr);
         w->set_dparent(v);
         w->splay(); // Recompute the aggregate for w
-        w->recompute_head();
-        w->recompute_tail();
     }
-    v->recompute_head();
-    v->recompute_tail();
     std::pair<LinkCutNode*, LinkCutNode*> paths = {v, w};
     return paths;
 }
@@ -292,8 +255,6 @@ LinkCutNode* LinkCutTree::expose(LinkCutNode* v) {
 LinkCutNode* LinkCutTree::evert(LinkCutNode* v) {
     LinkCutNode* p = this->expose(v);
     p->reverse();
-    p->recompute_head();
-    p->recompute_tail();
     return p;
 }
 
@@ -302,8 +263,8 @@ void LinkCutTree::link(node_id_t v, node_id_t w, uint32_t weight) {
     LinkCutNode* v_node = &this->nodes[v];
     LinkCutNode* w_node = &this->nodes[w];
     edge_id_t edge = (v < w) ? (((edge_id_t)v << 32) + w) : (((edge_id_t)w << 32) + v);
-    v_node->insert_edge(edge, weight);
-    w_node->insert_edge(edge, weight);
+    assert(this->edge_weights.count(edge) == 0);
+    this->edge_weights.insert({edge, weight});
     LinkCutNode* p_v = this->expose(v_node);
     LinkCutNode* p_w = this->evert(w_node);
     assert(p_v->get_tail() == v_node);
@@ -316,6 +277,8 @@ void LinkCutTree::cut(node_id_t v, node_id_t w) {
     LinkCutNode* v_node = &this->nodes[v];
     LinkCutNode* w_node = &this->nodes[w];
     edge_id_t edge = (v < w) ? (((edge_id_t)v << 32) + w) : (((edge_id_t)w << 32) + v);
+    assert(this->edge_weights.count(edge) == 1);
+    this->edge_weights.erase(edge);
     v_node->remove_edge(edge);
     w_node->remove_edge(edge);
     this->evert(v_node);
@@ -336,14 +299,59 @@ std::pair<edge_id_t, uint32_t> LinkCutTree::path_aggregate(node_id_t v, node_id_
     return p->get_max_edge();
 }
 
+PathMaxResult LinkCutTree::connected_path_max(node_id_t v, node_id_t w) {
+    LinkCutNode* v_node = &this->nodes[v];
+    LinkCutNode* w_node = &this->nodes[w];
+    // After everting v it is the head of the exposed path iff w is in the same tree
+    this->evert(v_node);
+    LinkCutNode* p = this->expose(w_node);
+    PathMaxResult result;
+    result.connected = p->get_head() == v_node;
+    if (result.connected) {
+        std::pair<edge_id_t, uint32_t> max = p->get_max_edge();
+        result.max_edge = max.first;
+        result.weight = max.second;
+    }
+    return result;
+}
+
+std::vector<PathMaxResult> LinkCutTree::connected_path_max(const std::vector<std::pair<node_id_t, node_id_t>>& queries) {
+    // Group the queries by first endpoint, exposing does not change the root of the represented tree
+    std::vector<uint32_t> order(queries.size());
+    for (uint32_t i = 0; i < queries.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&queries](uint32_t i, uint32_t j) {
+        return queries[i].first < queries[j].first;
+    });
+    std::vector<PathMaxResult> results(queries.size());
+    LinkCutNode* root = nullptr;
+    for (uint32_t i : order) {
+        LinkCutNode* v_node = &this->nodes[queries[i].first];
+        LinkCutNode* w_node = &this->nodes[queries[i].second];
+        if (v_node != root) {
+            this->evert(v_node);
+            root = v_node;
+        }
+        LinkCutNode* p = this->expose(w_node);
+        results[i].connected = p->get_head() == v_node;
+        if (results[i].connected) {
+            std::pair<edge_id_t, uint32_t> max = p->get_max_edge();
+            results[i].max_edge = max.first;
+            results[i].weight = max.second;
+        }
+    }
+    return results;
+}
+
 bool LinkCutTree::has_edge(node_id_t v1, node_id_t v2) {
     edge_id_t e = VERTICES_TO_EDGE(v1, v2);
-    return nodes[v1].has_edge(e);
+    return edge_weights.find(e) != edge_weights.end();
 }
 
 uint32_t LinkCutTree::get_edge_weight(node_id_t v1, node_id_t v2) {
     edge_id_t e = VERTICES_TO_EDGE(v1, v2);
-    return nodes[v1].get_edge_weight(e);
+    auto it = edge_weights.find(e);
+    return (it == edge_weights.end()) ? 0 : it->second;
 }
 
 std::vector<std::set<node_id_t>> LinkCutTree::get_cc() {
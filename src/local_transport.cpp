@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "../include/local_transport.h"
+
+// Broadcasts that can be in flight on a transport before a root waits for the slowest rank
+#define LOCAL_RING_SLOTS 256
+
+struct LocalSlot {
+    std::atomic<int64_t> sequence;  // broadcast held by the slot
+    std::atomic<int> readers{0};  // ranks that have not copied it out yet
+    std::vector<uint8_t> data;
+};
+
+struct LocalMessage {
+    int source;
+    int tag;
+    std::vector<uint8_t> data;
+};
+
+struct LocalMailbox {
+    std::mutex lock;
+    std::condition_variable arrived;
+    std::deque<LocalMessage> messages;
+};
+
+struct LocalContext {
+    int size;
+    std::vector<LocalSlot> ring;
+    std::vector<LocalMailbox> mailboxes;
+    alignas(64) std::atomic<int> barrier_count{0};
+    alignas(64) std::atomic<uint32_t> barrier_generation{0};
+    // Contributions of every rank to a reduction or split, read between two barriers
+    std::vector<const uint32_t*> reduce_inputs;
+    std::vector<uint32_t> reduce_values;
+    // The k-th dup or split of every rank gets the k-th child
+    std::mutex children_lock;
+    std::map<uint64_t, std::shared_ptr<LocalContext>> children;
+
+    LocalContext(int size) : size(size), ring(LOCAL_RING_SLOTS), mailboxes(size), reduce_inputs(size), reduce_values(size) {
+        for (int i = 0; i < LOCAL_RING_SLOTS; i++)
+            ring[i].sequence.store(i - LOCAL_RING_SLOTS);
+    }
+};
+
+struct LocalOperation : TransportOperation {
+    bool is_bcast;
+    void* message;
+    int size;
+    int peer;  // root of a broadcast or source of a receive
+    int tag;
+    int64_t sequence;
+    std::vector<TransportRequest> parts;  // receives of a neighbor exchange
+    bool done = false;
+};
+
+// Move the first message from source with tag out of the mailbox, the caller holds its lock
+static bool take_message(LocalMailbox& mailbox, int source, int tag, void* message, int size) {
+    auto it = std::find_if(mailbox.messages.begin(), mailbox.messages.end(),
+        [&](LocalMessage& m){ return m.source == source && m.tag == tag; });
+    if (it == mailbox.messages.end())
+        return false;
+    assert((int)it->data.size() <= size);
+    std::ignore = size;
+    memcpy(message, it->data.data(), it->data.size());
+    mailbox.messages.erase(it);
+    return true;
+}
+
+LocalTransport::LocalTransport(std::shared_ptr<LocalContext> context, int rank) : context(context), local_rank(rank) {}
+
+int LocalTransport::size() {
+    return context->size;
+}
+
+std::shared_ptr<LocalContext> LocalTransport::child_context(uint64_t key, int child_size) {
+    std::lock_guard<std::mutex> lk(context->children_lock);
+    std::shared_ptr<LocalContext>& child = context->children[key];
+    if (!child)
+        child = std::make_shared<LocalContext>(child_size);
+    return child;
+}
+
+std::unique_ptr<Transport> LocalTransport::dup() {
+    return std::unique_ptr<Transport>(new LocalTransport(child_context(next_child++, context->size), local_rank));
+}
+
+std::unique_ptr<Transport> LocalTransport::split(bool member) {
+    uint64_t key = next_child++;
+    context->reduce_values[local_rank] = member;
+    barrier();
+    int child_rank = 0, child_size = 0;
+    for (int r = 0; r < context->size; r++) {
+        child_rank += r < local_rank && context->reduce_values[r];
+        child_size += context->reduce_values[r];
+    }
+    barrier();
+    if (!member)
+        return nullptr;
+    return std::unique_ptr<Transport>(new LocalTransport(child_context(key, child_size), child_rank));
+}
+
+std::unique_ptr<Transport> LocalTransport::neighbors(const std::vector<int>& sources, const std::vector<int>& destinations) {
+    LocalTransport* transport = new LocalTransport(child_context(next_child++, context->size), local_rank);
+    transport->neighbor_sources = sources;
+    transport->neighbor_destinations = destinations;
+    return std::unique_ptr<Transport>(transport);
+}
+
+void LocalTransport::send(const void* message, int size, int dest, int tag) {
+    LocalMailbox& mailbox = context->mailboxes[dest];
+    const uint8_t* bytes = (const uint8_t*)message;
+    {
+        std::lock_guard<std::mutex> lk(mailbox.lock);
+        mailbox.messages.push_back({local_rank, tag, std::vector<uint8_t>(bytes, bytes+size)});
+    }
+    mailbox.arrived.notify_one();
+}
+
+void LocalTransport::recv(void* message, int size, int source, int tag) {
+    TransportRequest request = irecv(message, size, source, tag);
+    wait(request);
+}
+
+TransportRequest LocalTransport::isend(const void* message, int size, int dest, int tag) {
+    // The message is copied into the mailbox, so the send is complete once it returns
+    send(message, size, dest, tag);
+    return nullptr;
+}
+
+TransportRequest LocalTransport::irecv(void* message, int size, int source, int tag) {
+    LocalOperation* operation = new LocalOperation();
+    operation->is_bcast = false;
+    operation->message = message;
+    operation->size = size;
+    operation->peer = source;
+    operation->tag = tag;
+    posted_recvs.push_back(operation);
+    return TransportRequest(operation);
+}
+
+int LocalTransport::probe(int source, int tag) {
+    LocalMailbox& mailbox = context->mailboxes[local_rank];
+    std::unique_lock<std::mutex> lk(mailbox.lock);
+    while (true) {
+        for (LocalMessage& m : mailbox.messages)
+            if (m.source == source && m.tag == tag)
+                return m.data.size();
+        mailbox.arrived.wait(lk);
+    }
+}
+
+void LocalTransport::bcast(void* message, int size, int root) {
+    TransportRequest request = ibcast(message, size, root);
+    wait(request);
+}
+
+TransportRequest LocalTransport::ibcast(void* message, int size, int root) {
+    int64_t sequence = next_bcast++;
+    LocalSlot& slot = context->ring[sequence % LOCAL_RING_SLOTS];
+    if (local_rank == root) {
+        // Reuse the slot once every rank has copied out the broadcast before it
+        while (slot.sequence.load(std::memory_order_acquire) != sequence - LOCAL_RING_SLOTS
+                || slot.readers.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+        const uint8_t* bytes = (const uint8_t*)message;
+        slot.data.assign(bytes, bytes+size);
+        slot.readers.store(context->size-1, std::memory_order_relaxed);
+        slot.sequence.store(sequence, std::memory_order_release);
+        return nullptr;
+    }
+    LocalOperation* operation = new LocalOperation();
+    operation->is_bcast = true;
+    operation->message = message;
+    operation->size = size;
+    operation->peer = root;
+    operation->sequence = sequence;
+    return TransportRequest(operation);
+}
+
+uint32_t LocalTransport::allreduce_min(uint32_t value) {
+    context->reduce_values[local_rank] = value;
+    barrier();
+    uint32_t min = *std::min_element(context->reduce_values.begin(), context->reduce_values.end());
+    barrier();
+    return min;
+}
+
+void LocalTransport::reduce_bitwise_or(const uint32_t* send_data, uint32_t* recv_data, int count, int root) {
+    context->reduce_inputs[local_rank] = send_data;
+    barrier();
+    if (local_rank == root) {
+        for (int i = 0; i < count; i++) {
+            recv_data[i] = 0;
+            for (const uint32_t* input : context->reduce_inputs)
+                recv_data[i] |= input[i];
+        }
+    }
+    barrier();
+}
+
+void LocalTransport::barrier() {
+    uint32_t generation = context->barrier_generation.load(std::memory_order_acquire);
+    if (context->barrier_count.fetch_add(1, std::memory_order_acq_rel) == context->size-1) {
+        context->barrier_count.store(0, std::memory_order_relaxed);
+        context->barrier_generation.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    while (context->barrier_generation.load(std::memory_order_acquire) == generation)
+        std::this_thread::yield();
+}
+
+TransportRequest LocalTransport::ineighbor_alltoall(const void* send_data, void* recv_data, int size) {
+    // The transport only carries neighbor exchanges, so every message of one has the same tag
+    for (uint32_t i = 0; i < neighbor_destinations.size(); i++)
+        send((const uint8_t*)send_data + i*size, size, neighbor_destinations[i], 0);
+    LocalOperation* operation = new LocalOperation();
+    operation->is_bcast = false;
+    for (uint32_t i = 0; i < neighbor_sources.size(); i++)
+        operation->parts.push_back(irecv((uint8_t*)recv_data + i*size, size, neighbor_sources[i], 0));
+    operation->done = operation->parts.empty();
+    return TransportRequest(operation);
+}
+
+bool LocalTransport::complete(LocalOperation* operation, bool block) {
+    if (operation->done)
+        return true;
+    if (!operation->parts.empty()) {
+        for (auto& part : operation->parts)
+            if (part && !complete(static_cast<LocalOperation*>(part.get()), block))
+                return false;
+        operation->done = true;
+        return true;
+    }
+    if (operation->is_bcast) {
+        LocalSlot& slot = context->ring[operation->sequence % LOCAL_RING_SLOTS];
+        while (slot.sequence.load(std::memory_order_acquire) != operation->sequence) {
+            if (!block)
+                return false;
+            std::this_thread::yield();
+        }
+        assert((int)slot.data.size() == operation->size);
+        memcpy(operation->message, slot.data.data(), slot.data.size());
+        slot.readers.fetch_sub(1, std::memory_order_release);
+        operation->done = true;
+        return true;
+    }
+    // Receives from the same source with the same tag match messages in the order they were posted
+    LocalMailbox& mailbox = context->mailboxes[local_rank];
+    std::unique_lock<std::mutex> lk(mailbox.lock);
+    for (auto it = posted_recvs.begin(); !operation->done; ) {
+        LocalOperation* posted = *it;
+        if (posted->peer != operation->peer || posted->tag != operation->tag) {
+            it++;
+            continue;
+        }
+        while (!take_message(mailbox, posted->peer, posted->tag, posted->message, posted->size)) {
+            if (!block)
+                return false;
+            mailbox.arrived.wait(lk);
+        }
+        posted->done = true;
+        it = posted_recvs.erase(it);
+    }
+    return true;
+}
+
+void LocalTransport::wait(TransportRequest& request) {
+    if (!request)
+        return;
+    complete(static_cast<LocalOperation*>(request.get()), true);
+    request.reset();
+}
+
+void LocalTransport::waitall(std::vector<TransportRequest>& requests) {
+    for (auto& request : requests)
+        wait(request);
+}
+
+bool LocalTransport::test(TransportRequest& request) {
+    if (!request)
+        return true;
+    if (!complete(static_cast<LocalOperation*>(request.get()), false))
+        return false;
+    request.reset();
+    return true;
+}
+
+void run_local(int num_ranks, std::function<void(Transport&)> body) {
+    std::shared_ptr<LocalContext> world = std::make_shared<LocalContext>(num_ranks);
+    std::vector<std::thread> threads;
+    for (int r = 0; r < num_ranks; r++) {
+        threads.emplace_back([&, r]() {
+            LocalTransport transport(world, r);
+            body(transport);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,138 @@
+#include "../include/mpi_transport.h"
+
+
+struct MPIOperation : TransportOperation {
+    MPI_Request request = MPI_REQUEST_NULL;
+};
+
+MPITransport::MPITransport(MPI_Comm comm, bool owns_comm) : comm(comm), owns_comm(owns_comm) {}
+
+MPITransport::~MPITransport() {
+    if (owns_comm)
+        MPI_Comm_free(&comm);
+}
+
+int MPITransport::rank() {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+}
+
+int MPITransport::size() {
+    int size;
+    MPI_Comm_size(comm, &size);
+    return size;
+}
+
+std::unique_ptr<Transport> MPITransport::dup() {
+    MPI_Comm new_comm;
+    MPI_Comm_dup(comm, &new_comm);
+    return std::unique_ptr<Transport>(new MPITransport(new_comm, true));
+}
+
+std::unique_ptr<Transport> MPITransport::split(bool member) {
+    MPI_Comm new_comm;
+    MPI_Comm_split(comm, member ? 0 : MPI_UNDEFINED, rank(), &new_comm);
+    if (new_comm == MPI_COMM_NULL)
+        return nullptr;
+    return std::unique_ptr<Transport>(new MPITransport(new_comm, true));
+}
+
+std::unique_ptr<Transport> MPITransport::neighbors(const std::vector<int>& sources, const std::vector<int>& destinations) {
+    // Ranks are not reordered, the tier placement is by rank and comes from the rankfile instead
+    MPI_Comm new_comm;
+    MPI_Dist_graph_create_adjacent(comm, sources.size(), sources.data(), MPI_UNWEIGHTED,
+        destinations.size(), destinations.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &new_comm);
+    return std::unique_ptr<Transport>(new MPITransport(new_comm, true));
+}
+
+void MPITransport::send(const void* message, int size, int dest, int tag) {
+    MPI_Send(message, size, MPI_BYTE, dest, tag, comm);
+}
+
+void MPITransport::recv(void* message, int size, int source, int tag) {
+    MPI_Recv(message, size, MPI_BYTE, source, tag, comm, MPI_STATUS_IGNORE);
+}
+
+TransportRequest MPITransport::isend(const void* message, int size, int dest, int tag) {
+    MPIOperation* operation = new MPIOperation();
+    MPI_Isend(message, size, MPI_BYTE, dest, tag, comm, &operation->request);
+    return TransportRequest(operation);
+}
+
+TransportRequest MPITransport::irecv(void* message, int size, int source, int tag) {
+    MPIOperation* operation = new MPIOperation();
+    MPI_Irecv(message, size, MPI_BYTE, source, tag, comm, &operation->request);
+    return TransportRequest(operation);
+}
+
+int MPITransport::probe(int source, int tag) {
+    MPI_Status status;
+    int count;
+    MPI_Probe(source, tag, comm, &status);
+    MPI_Get_count(&status, MPI_BYTE, &count);
+    return count;
+}
+
+void MPITransport::bcast(void* message, int size, int root) {
+    MPI_Bcast(message, size, MPI_BYTE, root, comm);
+}
+
+TransportRequest MPITransport::ibcast(void* message, int size, int root) {
+    MPIOperation* operation = new MPIOperation();
+    MPI_Ibcast(message, size, MPI_BYTE, root, comm, &operation->request);
+    return TransportRequest(operation);
+}
+
+uint32_t MPITransport::allreduce_min(uint32_t value) {
+    uint32_t min;
+    MPI_Allreduce(&value, &min, 1, MPI_UINT32_T, MPI_MIN, comm);
+    return min;
+}
+
+void MPITransport::reduce_bitwise_or(const uint32_t* send_data, uint32_t* recv_data, int count, int root) {
+    MPI_Reduce(send_data, recv_data, count, MPI_UINT32_T, MPI_BOR, root, comm);
+}
+
+void MPITransport::barrier() {
+    MPI_Barrier(comm);
+}
+
+TransportRequest MPITransport::ineighbor_alltoall(const void* send_data, void* recv_data, int size) {
+    MPIOperation* operation = new MPIOperation();
+    MPI_Ineighbor_alltoall(send_data, size, MPI_BYTE, recv_data, size, MPI_BYTE, comm, &operation->request);
+    return TransportRequest(operation);
+}
+
+void MPITransport::wait(TransportRequest& request) {
+    if (!request)
+        return;
+    MPI_Wait(&static_cast<MPIOperation*>(request.get())->request, MPI_STATUS_IGNORE);
+    request.reset();
+}
+
+void MPITransport::waitall(std::vector<TransportRequest>& requests) {
+    std::vector<MPI_Request> mpi_requests;
+    mpi_requests.reserve(requests.size());
+    for (auto& request : requests)
+        if (request)
+            mpi_requests.push_back(static_cast<MPIOperation*>(request.get())->request);
+    MPI_Waitall(mpi_requests.size(), mpi_requests.data(), MPI_STATUSES_IGNORE);
+    for (auto& request : requests)
+        request.reset();
+}
+
+bool MPITransport::test(TransportRequest& request) {
+    if (!request)
+        return true;
+    int done;
+    MPI_Test(&static_cast<MPIOperation*>(request.get())->request, &done, MPI_STATUS_IGNORE);
+    if (done)
+        request.reset();
+    return done;
+}
+
+Transport& mpi_world() {
+    static MPITransport world(MPI_COMM_WORLD);
+    return world;
+}
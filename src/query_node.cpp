@@ -0,0 +1,55 @@
+#include <cassert>
+#include <cstring>
+
+#include "../include/mpi_nodes.h"
+
+
+QueryNode::QueryNode(node_id_t num_nodes, int seed, const GraphConfig& config, Transport& world) :
+    world(world), query_ett(num_nodes, 0, seed, config) {
+    assert(world.rank() == world.size()-1);
+    // Matches the split of the input node and the tier nodes, this rank is left out
+    world.split(false);
+}
+
+void QueryNode::apply_forest_changes(const EttUpdateMessage* changes, uint32_t num_changes) {
+    for (uint32_t i = 0; i < num_changes; i++) {
+        if (changes[i].type == CUT)
+            query_ett.cut(changes[i].endpoint1, changes[i].endpoint2);
+        else
+            query_ett.link(changes[i].endpoint1, changes[i].endpoint2);
+    }
+}
+
+void QueryNode::main() {
+    std::vector<uint8_t> buffer;
+    std::vector<EttUpdateMessage> changes;
+    std::vector<node_id_t> answer;
+    while (true) {
+        // Forest changes and queries come in the order the input node sent them, so every query
+        // is answered against the forest after the last batch processed before it was submitted
+        int count = world.probe(0, QUERY_NODE_TAG);
+        buffer.resize(count);
+        world.recv(buffer.data(), count, 0, QUERY_NODE_TAG);
+        QueryNodeMessage message;
+        memcpy(&message, buffer.data(), sizeof(QueryNodeMessage));
+        if (message.type == QUERY_NODE_END)
+            return;
+        if (message.type == FOREST_CHANGES) {
+            changes.resize(message.num_changes);
+            memcpy(changes.data(), buffer.data()+sizeof(QueryNodeMessage), sizeof(EttUpdateMessage)*message.num_changes);
+            apply_forest_changes(changes.data(), message.num_changes);
+            continue;
+        }
+        answer.clear();
+        if (message.type == CONNECTIVITY_QUERY) {
+            answer.push_back(query_ett.is_connected(message.a, message.b));
+        } else {
+            // Each component goes as its size followed by its vertices
+            for (auto& component : query_ett.cc_query()) {
+                answer.push_back(component.size());
+                answer.insert(answer.end(), component.begin(), component.end());
+            }
+        }
+        world.send(answer.data(), sizeof(node_id_t)*answer.size(), 0, QUERY_ANSWER_TAG);
+    }
+}
@@ -0,0 +1,298 @@
+#include "../include/rc_tree.h"
+#include <cassert>
+#include <algorithm>
+#include <limits>
+
+#define NO_PARTNER (std::numeric_limits<uint32_t>::max())
+#define NO_VALUE (std::numeric_limits<uint64_t>::max())
+
+RCTree::RCTree(node_id_t num_nodes, uint64_t seed) :
+    rounds(num_nodes, std::vector<Round>(1)), owner(num_nodes), partner(num_nodes, NO_PARTNER),
+    edge_weight(num_nodes, 0), chain_tail(num_nodes), free_nodes(num_nodes), seed(seed), visit_stamp(num_nodes, 0) {
+    for (node_id_t i = 0; i < num_nodes; i++) {
+        owner[i] = i;
+        chain_tail[i] = i;
+    }
+}
+
+bool RCTree::outranks(uint32_t node, uint32_t other, uint32_t round) {
+    auto priority = [&](uint32_t x) {
+        uint64_t h = seed ^ (((uint64_t)x << 32) | round);
+        h += 0x9e3779b97f4a7c15;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+        return h ^ (h >> 31);
+    };
+    uint64_t a = priority(node), b = priority(other);
+    return a > b || (a == b && node > other);
+}
+
+bool RCTree::contracts(uint32_t node, uint32_t round) {
+    Round& state = rounds[node][round];
+    if (state.degree == 0)
+        return true;
+    if (state.degree == 1) {
+        // Of two leaves joined to each other only the higher one rakes
+        uint32_t neighbor = state.neighbors[0];
+        return rounds[neighbor][round].degree != 1 || node > neighbor;
+    }
+    if (state.degree == 2) {
+        // Neighbors of a compressed node neither compress nor rake into it in the same round, so
+        // among neighboring degree two nodes only the one with the highest priority compresses
+        for (uint8_t i = 0; i < 2; i++) {
+            uint32_t neighbor = state.neighbors[i];
+            uint8_t degree = rounds[neighbor][round].degree;
+            if (degree == 1 || (degree == 2 && !outranks(node, neighbor, round)))
+                return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+void RCTree::add_base_edge(uint32_t a, uint32_t b, uint64_t value) {
+    for (auto [x, y] : {std::make_pair(a, b), std::make_pair(b, a)}) {
+        Round& state = rounds[x][0];
+        assert(state.degree < 3);
+        state.neighbors[state.degree] = y;
+        state.values[state.degree] = value;
+        state.degree++;
+        changed.push_back(x);
+    }
+}
+
+void RCTree::remove_base_edge(uint32_t a, uint32_t b) {
+    for (auto [x, y] : {std::make_pair(a, b), std::make_pair(b, a)}) {
+        Round& state = rounds[x][0];
+        uint8_t i = 0;
+        while (state.neighbors[i] != y)
+            i++;
+        assert(i < state.degree);
+        for (; i+1 < state.degree; i++) {
+            state.neighbors[i] = state.neighbors[i+1];
+            state.values[i] = state.values[i+1];
+        }
+        state.degree--;
+        changed.push_back(x);
+    }
+}
+
+uint32_t RCTree::take_free_node(node_id_t v) {
+    // The head of the chain is free exactly when it has no partner, it is never on the free list
+    if (partner[v] == NO_PARTNER)
+        return v;
+    if (!free_nodes[v].empty()) {
+        uint32_t node = free_nodes[v].back();
+        free_nodes[v].pop_back();
+        return node;
+    }
+    uint32_t node = rounds.size();
+    rounds.emplace_back(1);
+    owner.push_back(v);
+    partner.push_back(NO_PARTNER);
+    edge_weight.push_back(0);
+    visit_stamp.push_back(0);
+    add_base_edge(chain_tail[v], node, 0);
+    chain_tail[v] = node;
+    return node;
+}
+
+void RCTree::mark(uint32_t node) {
+    if (visit_stamp[node] == current_stamp)
+        return;
+    visit_stamp[node] = current_stamp;
+    recompute.push_back(node);
+}
+
+void RCTree::propagate() {
+    for (uint32_t round = 0; !changed.empty(); round++) {
+        // A node contracts based on the nodes around it and sees the contractions of its neighbors,
+        // so only nodes within two edges of a change can have a different next round
+        current_stamp++;
+        recompute.clear();
+        for (uint32_t node : changed) {
+            mark(node);
+            if (rounds[node].size() <= round)
+                continue;
+            Round& state = rounds[node][round];
+            for (uint8_t i = 0; i < state.degree; i++) {
+                mark(state.neighbors[i]);
+                Round& neighbor_state = rounds[state.neighbors[i]][round];
+                for (uint8_t j = 0; j < neighbor_state.degree; j++)
+                    mark(neighbor_state.neighbors[j]);
+            }
+        }
+        changed.clear();
+        for (uint32_t node : recompute) {
+            if (rounds[node].size() <= round)
+                continue;
+            if (contracts(node, round)) {
+                if (rounds[node].size() > round+1) {
+                    rounds[node].resize(round+1);
+                    changed.push_back(node);
+                }
+                continue;
+            }
+            Round& state = rounds[node][round];
+            Round next;
+            for (uint8_t i = 0; i < state.degree; i++) {
+                uint32_t neighbor = state.neighbors[i];
+                if (!contracts(neighbor, round)) {
+                    next.neighbors[next.degree] = neighbor;
+                    next.values[next.degree++] = state.values[i];
+                    continue;
+                }
+                // A raked neighbor disappears, a compressed one joins its two edges into one
+                Round& neighbor_state = rounds[neighbor][round];
+                if (neighbor_state.degree != 2)
+                    continue;
+                uint8_t far = neighbor_state.neighbors[0] == node ? 1 : 0;
+                next.neighbors[next.degree] = neighbor_state.neighbors[far];
+                next.values[next.degree++] = std::max(state.values[i], neighbor_state.values[far]);
+            }
+            if (rounds[node].size() == round+1) {
+                rounds[node].push_back(next);
+                changed.push_back(node);
+                continue;
+            }
+            Round& old = rounds[node][round+1];
+            bool same = old.degree == next.degree;
+            for (uint8_t i = 0; same && i < next.degree; i++)
+                same = old.neighbors[i] == next.neighbors[i] && old.values[i] == next.values[i];
+            if (!same) {
+                old = next;
+                changed.push_back(node);
+            }
+        }
+    }
+}
+
+void RCTree::link(node_id_t v, node_id_t w, uint32_t weight) {
+    assert(find_root(v) != find_root(w));
+    uint32_t x = take_free_node(v);
+    uint32_t y = take_free_node(w);
+    partner[x] = y;
+    partner[y] = x;
+    edge_weight[x] = edge_weight[y] = weight;
+    uint32_t key_node = v < w ? x : y;
+    edge_nodes[VERTICES_TO_EDGE(v, w)] = key_node;
+    add_base_edge(x, y, edge_key(key_node));
+    propagate();
+}
+
+void RCTree::cut(node_id_t v, node_id_t w) {
+    auto it = edge_nodes.find(VERTICES_TO_EDGE(v, w));
+    assert(it != edge_nodes.end());
+    uint32_t x = it->second;
+    uint32_t y = partner[x];
+    edge_nodes.erase(it);
+    remove_base_edge(x, y);
+    for (uint32_t node : {x, y}) {
+        partner[node] = NO_PARTNER;
+        if (node != owner[node])
+            free_nodes[owner[node]].push_back(node);
+    }
+    propagate();
+}
+
+uint32_t RCTree::find_root(node_id_t v) {
+    // The node a contracted node rakes or compresses into lives longer, the last one is the root
+    uint32_t node = v;
+    while (rounds[node].back().degree != 0)
+        node = rounds[node].back().neighbors[0];
+    return node;
+}
+
+PathMaxResult RCTree::connected_path_max(node_id_t v, node_id_t w) {
+    PathMaxResult result;
+    if (v == w) {
+        result.connected = true;
+        return result;
+    }
+    // The cluster holding each endpoint is bounded by at most two live nodes, which are adjacent
+    // when there are two. Keep them with the maximum edge on the path from the endpoint to them
+    struct Boundary {
+        uint32_t node;
+        uint64_t value;
+    };
+    Boundary boundaries[2][2] = {{{v, 0}}, {{w, 0}}};
+    uint8_t num_boundaries[2] = {1, 1};
+    node_id_t endpoints[2] = {v, w};
+    while (true) {
+        // The path goes through the first node that one endpoint's cluster reaches from the other
+        for (int i = 0; i < 2; i++) {
+            for (uint8_t j = 0; j < num_boundaries[i]; j++) {
+                Boundary& boundary = boundaries[i][j];
+                uint64_t value = NO_VALUE;
+                if (boundary.node == endpoints[1-i])
+                    value = boundary.value;
+                for (uint8_t k = 0; k < num_boundaries[1-i]; k++)
+                    if (boundaries[1-i][k].node == boundary.node)
+                        value = std::max(boundary.value, boundaries[1-i][k].value);
+                if (value == NO_VALUE)
+                    continue;
+                result.connected = true;
+                if (value != 0) {
+                    uint32_t node = value & 0xFFFFFFFF;
+                    result.weight = (value >> 32) - 1;
+                    result.max_edge = VERTICES_TO_EDGE(owner[node], owner[partner[node]]);
+                }
+                return result;
+            }
+        }
+        // Grow the cluster whose boundary contracts first, roots never contract into anything
+        uint32_t round = std::numeric_limits<uint32_t>::max();
+        for (int i = 0; i < 2; i++)
+            for (uint8_t j = 0; j < num_boundaries[i]; j++)
+                if (rounds[boundaries[i][j].node].back().degree != 0)
+                    round = std::min(round, (uint32_t)rounds[boundaries[i][j].node].size()-1);
+        if (round == std::numeric_limits<uint32_t>::max())
+            return result;
+        for (int i = 0; i < 2; i++) {
+            for (uint8_t j = 0; j < num_boundaries[i]; j++) {
+                Boundary boundary = boundaries[i][j];
+                if (rounds[boundary.node].size()-1 != round)
+                    continue;
+                Round& state = rounds[boundary.node][round];
+                if (state.degree == 0)
+                    continue;
+                Boundary& other = boundaries[i][1-j];
+                if (state.degree == 1) {
+                    // A rake into the other boundary leaves the cluster hanging from it
+                    if (num_boundaries[i] == 2 && other.node == state.neighbors[0]) {
+                        boundaries[i][0] = other;
+                        num_boundaries[i] = 1;
+                    } else {
+                        boundaries[i][j] = {state.neighbors[0], std::max(boundary.value, state.values[0])};
+                    }
+                } else if (num_boundaries[i] == 2) {
+                    // The compressed node's edge toward the other boundary joins the cluster
+                    uint8_t far = state.neighbors[0] == other.node ? 1 : 0;
+                    boundaries[i][j] = {state.neighbors[far], std::max(boundary.value, state.values[far])};
+                } else {
+                    boundaries[i][0] = {state.neighbors[0], std::max(boundary.value, state.values[0])};
+                    boundaries[i][1] = {state.neighbors[1], std::max(boundary.value, state.values[1])};
+                    num_boundaries[i] = 2;
+                }
+                break;
+            }
+        }
+    }
+}
+
+std::vector<PathMaxResult> RCTree::connected_path_max(const std::vector<std::pair<node_id_t, node_id_t>>& queries) {
+    std::vector<PathMaxResult> results;
+    results.reserve(queries.size());
+    for (auto query : queries)
+        results.push_back(connected_path_max(query.first, query.second));
+    return results;
+}
+
+bool RCTree::has_edge(node_id_t v1, node_id_t v2) {
+    return edge_nodes.count(VERTICES_TO_EDGE(v1, v2));
+}
+
+uint32_t RCTree::get_edge_weight(node_id_t v1, node_id_t v2) {
+    auto it = edge_nodes.find(VERTICES_TO_EDGE(v1, v2));
+    return it == edge_nodes.end() ? 0 : edge_weight[it->second];
+}
@@ -3,11 +3,11 @@
 #include <sketchless_euler_tour_tree.h>
 
 
-SketchlessEulerTourTree::SketchlessEulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed) {
-  // Initialize all the ETT node
+SketchlessEulerTourTree::SketchlessEulerTourTree(node_id_t num_nodes, uint32_t tier_num, int seed, const GraphConfig& config) : config(config) {
+  // Initialize all the ETT nodes, their skiplists are only built once the vertex is touched
   ett_nodes.reserve(num_nodes);
   for (node_id_t i = 0; i < num_nodes; ++i) {
-      ett_nodes.emplace_back(seed, i, tier_num);
+      ett_nodes.emplace_back(seed, i, tier_num, &this->config);
   }
 }
 
@@ -28,18 +28,17 @@ SketchlessSkipListNode* SketchlessEulerTourTree::get_root(node_id_t u) {
 }
 
 bool SketchlessEulerTourTree::is_connected(node_id_t u, node_id_t v) {
+  if (u == v)
+    return true;
+  // Untouched vertices are singletons and have no root to compare
+  if (!ett_nodes[u].is_touched() || !ett_nodes[v].is_touched())
+    return false;
   return get_root(u) == get_root(v);
 }
 
-SketchlessEulerTourNode::SketchlessEulerTourNode(long seed, node_id_t vertex, uint32_t tier) : seed(seed), vertex(vertex), tier(tier) {
-  // Initialize sentinel
-  this->make_edge(nullptr);
-}
+SketchlessEulerTourNode::SketchlessEulerTourNode(long seed, node_id_t vertex, uint32_t tier, const GraphConfig* config) : seed(seed), config(config), vertex(vertex), tier(tier) {}
 
-SketchlessEulerTourNode::SketchlessEulerTourNode(long seed) : seed(seed) {
-  // Initialize sentinel
-  this->make_edge(nullptr);
-}
+SketchlessEulerTourNode::SketchlessEulerTourNode(long seed) : seed(seed) {}
 
 SketchlessEulerTourNode::~SketchlessEulerTourNode(){
   
@@ -71,7 +70,19 @@ void SketchlessEulerTourNode::delete_edge(SketchlessEulerTourNode* other) {
   node_to_delete->uninit_element(true);
 }
 
+void SketchlessEulerTourNode::touch() {
+  // Initialize sentinel the first time this vertex is used
+  if (this->edges.empty())
+    this->make_edge(nullptr);
+}
+
+bool SketchlessEulerTourNode::is_touched() const {
+  return !this->edges.empty();
+}
+
 SketchlessSkipListNode* SketchlessEulerTourNode::get_root() {
+  if (!this->is_touched())
+    return nullptr;
   return this->allowed_caller->get_root();
 }
 
@@ -80,11 +91,15 @@ bool SketchlessEulerTourNode::has_edge_to(SketchlessEulerTourNode* other) {
 }
 
 std::set<SketchlessEulerTourNode*> SketchlessEulerTourNode::get_component() {
+  if (!this->is_touched())
+    return {this};
   return this->allowed_caller->get_component();
 }
 
 bool SketchlessEulerTourNode::link(SketchlessEulerTourNode& other) {
   assert(this->tier == other.tier);
+  this->touch();
+  other.touch();
   SketchlessSkipListNode* this_sentinel = this->edges.begin()->second->get_last();
   SketchlessSkipListNode* other_sentinel = other.edges.begin()->second->get_last();
 
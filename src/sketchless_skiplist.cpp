@@ -31,8 +31,9 @@ void SketchlessSkipListNode::uninit_element(bool delete_bdry) {
 
 SketchlessSkipListNode* SketchlessSkipListNode::init_element(SketchlessEulerTourNode* node) {
 	long seed = node->get_seed();
+	const GraphConfig* config = node->get_config();
 	// NOTE: WE SHOULD MAKE IT SO DIFFERENT SKIPLIST NODES FOR THE SAME ELEMENT CAN BE DIFFERENT HEIGHTS
-	uint64_t element_height = sketchless_height_factor*__builtin_ctzll(XXH3_64bits_withSeed(&node->vertex, sizeof(node_id_t), sketchless_skiplist_seed))+1;
+	uint64_t element_height = config->sketchless_height_factor*__builtin_ctzll(XXH3_64bits_withSeed(&node->vertex, sizeof(node_id_t), config->sketchless_skiplist_seed))+1;
 	SketchlessSkipListNode* list_node, *bdry_node, *list_prev, *bdry_prev;
 	list_node = bdry_node = list_prev = bdry_prev = nullptr;
 	// Add skiplist and boundary nodes up to the random height
@@ -10,12 +10,22 @@ long skiplist_seed = time(NULL);
 vec_t sketch_len;
 vec_t sketch_err;
 
-SkipListNode::SkipListNode(EulerTourNode* node, long seed, bool has_sketch) : node(node) {
-	if (has_sketch) sketch_agg = new Sketch(sketch_len, seed, 1, sketch_err);
+SkipListNode::SkipListNode(EulerTourNode* node, const GraphConfig* config, const std::vector<long>* shared_seeds, long seed, bool has_sketch) :
+    node(node), config(config), shared_seeds(shared_seeds) {
+	if (!has_sketch) {
+		if (shared_seeds) shared_aggs.resize(shared_seeds->size(), nullptr);
+		return;
+	}
+	sketch_agg = new Sketch(config->sketch_len, seed, 1, config->sketch_err);
+	if (shared_seeds)
+		for (long shared_seed : *shared_seeds)
+			shared_aggs.push_back(new Sketch(config->sketch_len, shared_seed, 1, config->sketch_err));
 }
 
 SkipListNode::~SkipListNode() {
 	if (sketch_agg) delete sketch_agg;
+	for (Sketch* agg : shared_aggs)
+		if (agg) delete agg;
 }
 
 void SkipListNode::uninit_element(bool delete_bdry) {
@@ -39,18 +49,20 @@ void SkipListNode::uninit_element(bool delete_bdry) {
 
 SkipListNode* SkipListNode::init_element(EulerTourNode* node, bool is_allowed_caller) {
 	long seed = node->get_seed();
+	const GraphConfig* config = node->get_config();
+	const std::vector<long>* shared_seeds = node->get_shared_seeds();
 	// NOTE: WE SHOULD MAKE IT SO DIFFERENT SKIPLIST NODES FOR THE SAME ELEMENT CAN BE DIFFERENT HEIGHTS
-	uint64_t element_height = height_factor*__builtin_ctzll(XXH3_64bits_withSeed(&node->vertex, sizeof(node_id_t), skiplist_seed))+1;
+	uint64_t element_height = config->height_factor*__builtin_ctzll(XXH3_64bits_withSeed(&node->vertex, sizeof(node_id_t), config->skiplist_seed))+1;
 	SkipListNode* list_node, *bdry_node, *list_prev, *bdry_prev;
 	list_node = bdry_node = list_prev = bdry_prev = nullptr;
 	// Add skiplist and boundary nodes up to the random height
 	for (uint64_t i = 0; i < element_height; i++) {
 		if (i == 0) {
-			list_node = new SkipListNode(node, seed, is_allowed_caller);
-			bdry_node = new SkipListNode(nullptr, seed, false);
+			list_node = new SkipListNode(node, config, shared_seeds, seed, is_allowed_caller);
+			bdry_node = new SkipListNode(nullptr, config, shared_seeds, seed, false);
 		} else {
-			list_node = new SkipListNode(node, seed, true);
-			bdry_node = new SkipListNode(nullptr, seed, true);
+			list_node = new SkipListNode(node, config, shared_seeds, seed, true);
+			bdry_node = new SkipListNode(nullptr, config, shared_seeds, seed, true);
 		}
 		list_node->left = bdry_node;
 		bdry_node->right = list_node;
@@ -68,7 +80,7 @@ SkipListNode* SkipListNode::init_element(EulerTourNode* node, bool is_allowed_ca
 		bdry_prev = bdry_node;
 	}
 	// Add one more boundary node at height+1
-	SkipListNode* root = new SkipListNode(nullptr, seed, true);
+	SkipListNode* root = new SkipListNode(nullptr, config, shared_seeds, seed, true);
 	root->down = bdry_prev;
 	bdry_prev->up = root;
 	bdry_prev->parent = root;
@@ -142,9 +154,41 @@ void SkipListNode::process_updates() {
 		return;
 	for (int i = 0; i < buffer_size; ++i)
 		this->sketch_agg->update(update_buffer[i]);
+	// The tiers sharing the list see the same updates through their own sketches
+	for (Sketch* agg : shared_aggs)
+		for (int i = 0; i < buffer_size; ++i)
+			agg->update(update_buffer[i]);
 	this->buffer_size = 0;
 }
 
+void SkipListNode::merge_aggs(SkipListNode* other) {
+	this->sketch_agg->merge(*other->sketch_agg);
+	for (uint32_t i = 0; i < shared_aggs.size(); i++)
+		shared_aggs[i]->merge(*other->shared_aggs[i]);
+}
+
+void SkipListNode::zero_aggs() {
+	this->sketch_agg->zero_contents();
+	for (Sketch* agg : shared_aggs)
+		agg->zero_contents();
+}
+
+void SkipListNode::add_column_shared_agg(long seed) {
+	for (SkipListNode* curr = this; curr; curr = curr->up) {
+		// Buffered updates belong to the existing aggregates only
+		curr->process_updates();
+		curr->shared_aggs.push_back(curr->sketch_agg ? new Sketch(config->sketch_len, seed, 1, config->sketch_err) : nullptr);
+	}
+}
+
+void SkipListNode::remove_column_shared_aggs(uint32_t shared_tier) {
+	for (SkipListNode* curr = this; curr; curr = curr->up) {
+		for (uint32_t i = shared_tier; i < curr->shared_aggs.size(); i++)
+			if (curr->shared_aggs[i]) delete curr->shared_aggs[i];
+		curr->shared_aggs.resize(shared_tier);
+	}
+}
+
 SkipListNode* SkipListNode::update_path_agg(vec_t update_idx) {
 	SkipListNode* curr = this;
 	SkipListNode* prev;
@@ -170,6 +214,31 @@ SkipListNode* SkipListNode::update_path_agg(Sketch* sketch) {
 	return prev;
 }
 
+SkipListNode* SkipListNode::update_shared_path_agg(uint32_t shared_tier, Sketch* sketch) {
+	SkipListNode* curr = this;
+	SkipListNode* prev;
+	while (curr) {
+		if (!curr->shared_aggs[shared_tier])
+			curr->shared_aggs[shared_tier] = sketch;
+		else
+			curr->shared_aggs[shared_tier]->merge(*sketch);
+		prev = curr;
+		curr = prev->get_parent();
+	}
+	return prev;
+}
+
+SkipListNode* SkipListNode::update_path_agg(SkipListNode* other) {
+	SkipListNode* curr = this;
+	SkipListNode* prev;
+	while (curr) {
+		curr->merge_aggs(other);
+		prev = curr;
+		curr = prev->get_parent();
+	}
+	return prev;
+}
+
 std::set<EulerTourNode*> SkipListNode::get_component() {
 	std::set<EulerTourNode*> nodes;
 	SkipListNode* curr = this->get_first()->right; //Skip over the boundary node
@@ -198,6 +267,8 @@ SkipListNode* SkipListNode::join(SkipListNode* left, SkipListNode* right) {
 
 	long seed = left->sketch_agg ? left->sketch_agg->get_seed()
 	 : left->get_parent()->sketch_agg->get_seed();
+	const GraphConfig* config = left->config;
+	const std::vector<long>* shared_seeds = left->shared_seeds;
 
 	SkipListNode* l_curr = left->get_last();
 	SkipListNode* r_curr = right->get_first(); // this is the bottom boundary node
@@ -212,7 +283,7 @@ SkipListNode* SkipListNode::join(SkipListNode* left, SkipListNode* right) {
 		if (r_curr->right) r_curr->right->left = l_curr; // skip over boundary node, but to the left
 		r_curr->process_updates();
 		if (l_curr->sketch_agg && r_curr->sketch_agg) // Only if that skiplist node has a sketch
-			l_curr->sketch_agg->merge(*r_curr->sketch_agg);
+			l_curr->merge_aggs(r_curr);
 		l_curr->size += r_curr->size-1;
 
 		if (r_prev) delete r_prev; // Delete old boundary nodes
@@ -224,7 +295,7 @@ SkipListNode* SkipListNode::join(SkipListNode* left, SkipListNode* right) {
 
 	// If left list was taller add the root agg in right to the rest in left
 	while (l_curr) {
-		l_curr->sketch_agg->merge(*r_prev->sketch_agg);
+		l_curr->merge_aggs(r_prev);
 		l_curr->size += r_prev->size-1;
 		l_prev = l_curr;
 		l_curr = l_prev->get_parent();
@@ -233,23 +304,23 @@ SkipListNode* SkipListNode::join(SkipListNode* left, SkipListNode* right) {
 	// If right list was taller add new boundary nodes to left list
 	if (r_curr) {
 		// Cache the left root to initialize the new boundary nodes
-		Sketch* l_root_agg = new Sketch(sketch_len, seed, 1, sketch_err);
+		SkipListNode l_root_agg(nullptr, config, shared_seeds, seed, true);
 		l_prev->process_updates();
-		l_root_agg->merge(*l_prev->sketch_agg);
-		l_root_agg->merge(*r_prev->sketch_agg);
+		l_root_agg.merge_aggs(l_prev);
+		l_root_agg.merge_aggs(r_prev);
 		uint32_t l_root_size = l_prev->size - (r_prev->size-1);
 		while (r_curr) {
-			l_curr = new SkipListNode(nullptr, seed, true);
+			l_curr = new SkipListNode(nullptr, config, shared_seeds, seed, true);
 			l_curr->down = l_prev;
 			l_prev->up = l_curr;
 			l_prev->parent = l_curr;
 			l_curr->right = r_curr->right;
 			if (r_curr->right) r_curr->right->left = l_curr;
 
-			l_curr->sketch_agg->merge(*l_root_agg);
+			l_curr->merge_aggs(&l_root_agg);
 			l_curr->size = l_root_size;
 			r_curr->process_updates();
-			l_curr->sketch_agg->merge(*r_curr->sketch_agg);
+			l_curr->merge_aggs(r_curr);
 			l_curr->size += r_curr->size-1;
 
 			if (r_prev) delete r_prev; // Delete old boundary nodes
@@ -257,7 +328,6 @@ SkipListNode* SkipListNode::join(SkipListNode* left, SkipListNode* right) {
 			r_prev = r_curr;
 			r_curr = r_prev->up;
 		}
-		delete l_root_agg;
 	}
 	delete r_prev;
 	// Update parent pointers in right list
@@ -280,31 +350,33 @@ SkipListNode* SkipListNode::split_left(SkipListNode* node) {
 		return nullptr;
 	}
 	long seed = node->node->get_seed();
+	const GraphConfig* config = node->config;
+	const std::vector<long>* shared_seeds = node->shared_seeds;
 	// Construct new boundary nodes with correct aggregates for the right component
 	// New aggs will be sum of all aggs on each level in the right path
 	// Subtract those new aggregates from the "corners" of the left path
 	// And unlink the nodes and link with the  new boundary nodes
 	SkipListNode* r_curr = node;
 	SkipListNode* l_curr = node->left;
-	SkipListNode* bdry = new SkipListNode(nullptr, seed, false);
+	SkipListNode* bdry = new SkipListNode(nullptr, config, shared_seeds, seed, false);
 	SkipListNode* new_bdry;
 	while (r_curr) {
 		r_curr->left = bdry;
 		bdry->right = r_curr;
 		l_curr->right = nullptr;
 		if (l_curr->sketch_agg && bdry->sketch_agg) // Only if its not the bottom sketchless node
-			l_curr->sketch_agg->merge(*bdry->sketch_agg); // XOR addition same as subtraction
+			l_curr->merge_aggs(bdry); // XOR addition same as subtraction
 		l_curr->size -= bdry->size-1;
 		// Get next l_curr, r_curr, and bdry
 		l_curr = l_curr->get_parent();
-		new_bdry = new SkipListNode(nullptr, seed, true);
+		new_bdry = new SkipListNode(nullptr, config, shared_seeds, seed, true);
 		if (bdry->sketch_agg) // Only if its not the bottom sketchless node
-			new_bdry->sketch_agg->merge(*bdry->sketch_agg);
+			new_bdry->merge_aggs(bdry);
 		new_bdry->size = bdry->size;
 		while (r_curr && !r_curr->up) {
 			r_curr->process_updates();
 			if (r_curr->sketch_agg) // Only if that skiplist node has a sketch
-				new_bdry->sketch_agg->merge(*r_curr->sketch_agg);
+				new_bdry->merge_aggs(r_curr);
 			new_bdry->size += r_curr->size;
 			r_curr->parent = new_bdry;
 			r_curr = r_curr->right;
@@ -318,7 +390,7 @@ SkipListNode* SkipListNode::split_left(SkipListNode* node) {
 	// Subtract the final right agg from the rest of the aggs on left path
 	SkipListNode* l_prev = nullptr;
 	while (l_curr) {
-		l_curr->sketch_agg->merge(*bdry->sketch_agg); // XOR addition same as subtraction
+		l_curr->merge_aggs(bdry); // XOR addition same as subtraction
 		l_curr->size -= bdry->size-1;
 		l_prev  = l_curr;
 		l_curr = l_curr->get_parent();
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+
 #include "../include/mpi_nodes.h"
 
 
@@ -9,243 +14,583 @@ long normal_refresh_time = 0;
 long greedy_batch_gather_time = 0;
 long size_message_passing_time = 0;
 
-TierNode::TierNode(node_id_t num_nodes, uint32_t tier_num, uint32_t num_tiers, int batch_size, int seed) :
-    tier_num(tier_num), num_tiers(num_tiers), batch_size(batch_size), ett(num_nodes, tier_num, seed) {
-    update_buffer = (UpdateMessage*) malloc(sizeof(UpdateMessage)*(batch_size+1));
+static long microseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+TierState::TierState(node_id_t num_nodes, uint32_t tier_num, int batch_size, int seed, const GraphConfig& config) :
+    ett(num_nodes, tier_num, seed, config), tier_num(tier_num) {
     this_sizes_buffer = (GreedyRefreshMessage*) malloc(sizeof(GreedyRefreshMessage)*batch_size);
     next_sizes_buffer = (GreedyRefreshMessage*) malloc(sizeof(GreedyRefreshMessage)*batch_size);
     query_result_buffer = (SampleResult*) malloc(sizeof(SampleResult)*batch_size*2);
     split_revert_buffer = (bool*) malloc(sizeof(bool)*batch_size);
+    staged_sketch = new Sketch(config.sketch_len, seed, 1, config.sketch_err);
+    staged_roots.resize(batch_size+1);
 }
 
-TierNode::~TierNode() {
-    free(update_buffer);
+TierState::~TierState() {
     free(this_sizes_buffer);
     free(next_sizes_buffer);
     free(query_result_buffer);
     free(split_revert_buffer);
+    delete staged_sketch;
+}
+
+TierNode::TierNode(node_id_t num_nodes, uint32_t num_tiers, int batch_size, int seed, const GraphConfig& config, uint32_t num_threads,
+    Transport& world) :
+    num_nodes(num_nodes), num_tiers(num_tiers), comm(world.split(true)), batch_size(batch_size), world_rank(world.rank()),
+    placement(num_tiers, comm->size()-1),
+    pool(placement.num_tiers_on(world_rank), num_threads) {
+    uint32_t first_tier = placement.first_tier(world_rank);
+    for (uint32_t i = 0; i < placement.num_tiers_on(world_rank); i++)
+        tiers.emplace_back(new TierState(num_nodes, first_tier+i, batch_size, seed+i, config));
+    batch_comm = comm->dup();
+    std::unique_ptr<Transport> tier_comm = comm->split(true);
+    std::vector<int> sources, destinations;
+    if (tiers.back()->tier_num != num_tiers-1)
+        sources.push_back(placement.rank_of(tiers.back()->tier_num+1)-1);
+    if (tiers.front()->tier_num != 0)
+        destinations.push_back(placement.rank_of(tiers.front()->tier_num-1)-1);
+    chain_comm = tier_comm->neighbors(sources, destinations);
+    update_buffer = (GraphUpdate*) malloc(sizeof(GraphUpdate)*(batch_size+1));
+    batch_payload = (uint8_t*) malloc(max_payload_bytes(batch_size));
+    size_requests.reserve(2*(batch_size/size_message_chunk+1));
+    isolated_bitmap.resize((batch_size+31)/32);
+    refresh_selection.resize(batch_size+2);
+    lct_revert_buffer.resize(batch_size);
+}
+
+TierNode::~TierNode() {
+    free(update_buffer);
+    free(batch_payload);
 }
 
 void TierNode::main() {
+    header_request = batch_comm->ibcast(&next_header, sizeof(BatchHeader), 0);
     while (true) {
         // Receive a batch of updates and check if it is the end of stream
-        bcast(update_buffer, sizeof(UpdateMessage)*(batch_size+1), 0);
-        if (update_buffer[0].end) {
-            // std::cout << "============= TIER " << tier_num << " NODE =============" << std::endl;
+        batch_comm->wait(header_request);
+        assert(next_header.version == WIRE_FORMAT_VERSION);
+        BatchHeader header = next_header;
+        if (header.flags & BATCH_END) {
+            // std::cout << "============= TIER " << tiers[0]->tier_num << " NODE =============" << std::endl;
             // std::cout << "Greedy batch time (ms): " << greedy_batch_time/1000 << std::endl;
             // std::cout << "\tSketch update time (ms): " << sketch_update_time/1000 << std::endl;
             // std::cout << "\tSketch query time (ms): " << sketch_query_time/1000 << std::endl;
             // std::cout << "\tSize message passing time (ms): " << size_message_passing_time/1000 << std::endl;
             // std::cout << "\tGreedy gather time (ms): " << greedy_batch_gather_time/1000 << std::endl;
             // std::cout << "Normal refresh time (ms): " << normal_refresh_time/1000 << std::endl;
+            for (auto& tier : tiers)
+                std::cout << "Tier " << tier->tier_num << " refresh idle time (ms): " << tier->refresh_idle_time/1000 << std::endl;
             return;
         }
-        uint32_t num_updates = update_buffer[0].update.edge.src;
-        using_sliding_window = (bool)update_buffer[0].update.edge.dst;
-        // Do the greedy refresh check for all updates in the batch
-        START(greedy_batch_timer);
-        START(sketch_update_timer);
-        for (uint32_t i = 0; i < num_updates; i++) {
-            // Perform the sketch updating or root finding
-            GraphUpdate update = update_buffer[i+1].update;
-            edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
-            split_revert_buffer[i] = false;
-            unlikely_if (update.type == DELETE && ett.has_edge(update.edge.src, update.edge.dst)) {
-                ett.cut(update.edge.src, update.edge.dst);
-                ENDPOINT_CANARY("Cutting ETT With", update.edge.src, update.edge.dst);
-                split_revert_buffer[i] = true;
+        uint32_t num_updates = header.num_updates;
+        assert(num_updates <= (uint32_t)batch_size);
+        // Nonblocking like the broadcast of the input node, a blocking broadcast would not match it
+        TransportRequest batch_request = batch_comm->ibcast(batch_payload, header.payload_bytes, 0);
+        batch_comm->wait(batch_request);
+        // The next header is received in the background so the input node never waits on this tier to send it
+        header_request = batch_comm->ibcast(&next_header, sizeof(BatchHeader), 0);
+        decode_updates(batch_payload, num_updates, header.flags, &update_buffer[1]);
+        using_sliding_window = header.flags & BATCH_SLIDING_WINDOW;
+        concurrent_refresh = header.flags & BATCH_CONCURRENT_REFRESH;
+        // The input node sets the flag on every batch, so the replica sees the forest from the start
+        if ((header.flags & BATCH_REPLICATED_LCT) && !lct_replica)
+            lct_replica.reset(new DynamicTree(num_nodes));
+        // Greedily check the batch, then resolve the first isolated update and check the rest again
+        uint32_t first_update = 1;
+        while (first_update <= num_updates) {
+            START(greedy_batch_timer);
+            if (lct_replica)
+                cut_replica(first_update, num_updates);
+            int isolated_update = greedy_check(first_update, num_updates);
+            if (concurrent_refresh) {
+                // Report every isolated update, the input node picks the ones that can be resolved together
+                START(greedy_batch_gather_timer);
+                comm->reduce_bitwise_or(isolated_bitmap.data(), nullptr, isolated_bitmap.size(), 0);
+                comm->bcast(refresh_selection.data(), sizeof(uint32_t)*refresh_selection.size(), 0);
+                STOP(greedy_batch_gather_time, greedy_batch_gather_timer);
+                STOP(greedy_batch_time, greedy_batch_timer);
+                uint32_t next_update = refresh_selection[0];
+                uint32_t num_refreshes = refresh_selection[1];
+                if (num_refreshes == 0)
+                    break;
+                // Every update before next_update is resolved by this round and keeps its speculative cut
+                pool.for_tiers(0, tiers.size(), [&](uint32_t i) {
+                    TierState& tier = *tiers[i];
+                    for (uint32_t update_idx = next_update; update_idx < num_updates+1; update_idx++) {
+                        GraphUpdate update = update_buffer[update_idx];
+                        unlikely_if (tier.split_revert_buffer[update_idx-1]) {
+                            tier.ett.link(update.edge.src, update.edge.dst);
+                        }
+                    }
+                });
+                if (lct_replica)
+                    relink_replica(next_update, num_updates);
+                refresh_updates(&refresh_selection[2], num_refreshes, num_updates);
+                first_update = next_update;
+                continue;
             }
-            auto roots = ett.update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
-            ENDPOINT_CANARY("Updating Sketch With", update.edge.src, update.edge.dst);
-            roots.first->process_updates();
-            roots.first->sketch_agg->reset_sample_state();
-            query_result_buffer[2*i] = roots.first->sketch_agg->sample().result;
-            roots.second->process_updates();
-            roots.second->sketch_agg->reset_sample_state();
-            query_result_buffer[2*i+1] = roots.second->sketch_agg->sample().result;
-    
-            // Prepare greedy batch size messages
-            GreedyRefreshMessage this_sizes;
-            this_sizes.size1 = roots.first->size;
-            this_sizes.size2 = roots.second->size;
-            this_sizes_buffer[i] = this_sizes;
-        }
-        STOP(sketch_update_time, sketch_update_timer);
-        START(size_message_passing_timer);
-        if (tier_num == 0) {
-            MPI_Recv(next_sizes_buffer, batch_size*sizeof(GreedyRefreshMessage), MPI_BYTE, tier_num+2, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        } else if (tier_num == num_tiers-1) {
-            MPI_Send(this_sizes_buffer, batch_size*sizeof(GreedyRefreshMessage), MPI_BYTE, tier_num, 0, MPI_COMM_WORLD);
-        } else if (tier_num%2 == 0) {
-            MPI_Send(this_sizes_buffer, batch_size*sizeof(GreedyRefreshMessage), MPI_BYTE, tier_num, 0, MPI_COMM_WORLD);
-            MPI_Recv(next_sizes_buffer, batch_size*sizeof(GreedyRefreshMessage), MPI_BYTE, tier_num+2, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        } else if (tier_num%2 == 1) {
-            MPI_Recv(next_sizes_buffer, batch_size*sizeof(GreedyRefreshMessage), MPI_BYTE, tier_num+2, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            MPI_Send(this_sizes_buffer, batch_size*sizeof(GreedyRefreshMessage), MPI_BYTE, tier_num, 0, MPI_COMM_WORLD);
-        }
-        STOP(size_message_passing_time, size_message_passing_timer);
-        START(sketch_query_timer);
-        int isolated_update;
-        // Check if this tier is isolated for each update
-        isolated_update = MAX_INT;
-        for (uint32_t i = 0; i < num_updates; i++) {
-            // Check if this tier is isolated for this update
-            if (tier_num != num_tiers-1) {
-                if (this_sizes_buffer[i].size1 == next_sizes_buffer[i].size1)
-                    if (query_result_buffer[2*i] == GOOD) {
-                        isolated_update = i+1;
-                        break;
+            START(greedy_batch_gather_timer);
+            int minimum_isolated_update = comm->allreduce_min(isolated_update);
+            // Check for any isolation on any update on any tier
+            STOP(greedy_batch_gather_time, greedy_batch_gather_timer);
+            STOP(greedy_batch_time, greedy_batch_timer);
+            if (minimum_isolated_update == MAX_INT)
+                break;
+            // The isolated update keeps its speculative cut and sketch update. The updates after it stay
+            // staged in the sketches and are removed from samples instead of being undone and redone,
+            // so only their speculative cuts are rolled back to restore the forest
+            pool.for_tiers(0, tiers.size(), [&](uint32_t i) {
+                TierState& tier = *tiers[i];
+                for (uint32_t update_idx = minimum_isolated_update+1; update_idx < num_updates+1; update_idx++) {
+                    GraphUpdate update = update_buffer[update_idx];
+                    // There could be a cut on a later update that needs to be rolled back
+                    unlikely_if (tier.split_revert_buffer[update_idx-1]) {
+                        tier.ett.link(update.edge.src, update.edge.dst);
                     }
-                if (this_sizes_buffer[i].size2 == next_sizes_buffer[i].size2)
-                    if (query_result_buffer[2*i+1] == GOOD) {
-                        isolated_update = i+1;
-                        break;
+                    // The sliding window sends the rest of the batch again so it must be fully undone
+                    if (using_sliding_window) {
+                        edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
+                        tier.ett.update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
                     }
-            }
+                }
+            });
+            if (lct_replica)
+                relink_replica(minimum_isolated_update+1, num_updates);
+            refresh_update(minimum_isolated_update, using_sliding_window ? 0 : num_updates);
+            if (using_sliding_window)
+                break;
+            first_update = minimum_isolated_update+1;
         }
-        STOP(sketch_query_time, sketch_query_timer);
-        START(greedy_batch_gather_timer);
-        int minimum_isolated_update;
-        allreduce(&isolated_update, &minimum_isolated_update);
-        // Check for any isolation on any update on any tier
-        STOP(greedy_batch_gather_time, greedy_batch_gather_timer);
-        STOP(greedy_batch_time, greedy_batch_timer);
-        if (minimum_isolated_update == MAX_INT)
+    }
+}
+
+int TierNode::greedy_check(uint32_t first_update, uint32_t num_updates) {
+    size_requests.clear();
+    START(sketch_update_timer);
+    // Only the calling thread may use MPI, it sends the sizes of the lowest tier while it waits for the workers
+    sizes_ready.store(first_update-1, std::memory_order_relaxed);
+    sizes_sent = first_update-1;
+    pool.for_tiers(0, tiers.size(), [&](uint32_t i) {
+        check_tier(*tiers[i], first_update, num_updates, i == 0);
+    }, [&]() { exchange_ready_sizes(num_updates); });
+    exchange_ready_sizes(num_updates);
+    STOP(sketch_update_time, sketch_update_timer);
+    START(size_message_passing_timer);
+    chain_comm->waitall(size_requests);
+    STOP(size_message_passing_time, size_message_passing_timer);
+    START(sketch_query_timer);
+    // Check if each tier is isolated for each update, a tier compares its sizes with the tier above
+    int isolated_update = MAX_INT;
+    if (concurrent_refresh)
+        std::fill(isolated_bitmap.begin(), isolated_bitmap.end(), 0);
+    for (uint32_t t = 0; t < tiers.size(); t++) {
+        TierState& tier = *tiers[t];
+        if (tier.tier_num == num_tiers-1)
+            break;
+        GreedyRefreshMessage* next_sizes = (t+1 < tiers.size()) ? tiers[t+1]->this_sizes_buffer : tier.next_sizes_buffer;
+        for (uint32_t i = first_update-1; i < num_updates; i++) {
+            bool isolated = (tier.this_sizes_buffer[i].size1 == next_sizes[i].size1 && tier.query_result_buffer[2*i] == GOOD)
+                || (tier.this_sizes_buffer[i].size2 == next_sizes[i].size2 && tier.query_result_buffer[2*i+1] == GOOD);
+            if (!isolated)
+                continue;
+            isolated_update = std::min(isolated_update, (int)i+1);
+            // The concurrent refresh needs every isolated update, not just the first
+            if (!concurrent_refresh)
+                break;
+            isolated_bitmap[i/32] |= 1u << (i%32);
+        }
+    }
+    STOP(sketch_query_time, sketch_query_timer);
+    return isolated_update;
+}
+
+void TierNode::check_tier(TierState& tier, uint32_t first_update, uint32_t num_updates, bool lowest) {
+    // Updates after the first check of the batch already have their sketch updates applied
+    bool staged = first_update != 1;
+    if (staged)
+        cache_staged_roots(tier, first_update, num_updates);
+    for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++) {
+        uint32_t i = update_idx-1;
+        // Perform the sketch updating or root finding
+        GraphUpdate update = update_buffer[update_idx];
+        edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
+        tier.split_revert_buffer[i] = false;
+        unlikely_if (update.type == DELETE && tier.ett.has_edge(update.edge.src, update.edge.dst)) {
+            tier.ett.cut(update.edge.src, update.edge.dst);
+            ENDPOINT_CANARY("Cutting ETT With", update.edge.src, update.edge.dst);
+            tier.split_revert_buffer[i] = true;
+            if (staged)
+                cache_staged_roots(tier, update_idx+1, num_updates);
+        }
+        SketchUpdateResult roots;
+        if (staged) {
+            roots.root1 = tier.ett.get_root(update.edge.src);
+            roots.root2 = tier.ett.get_root(update.edge.dst);
+            // The first check of the batch applied the sketch update, which touched both endpoints
+            assert(roots.root1 != nullptr && roots.root2 != nullptr);
+            roots.root_unchanged = roots.root1 == roots.root2;
+        } else {
+            roots = tier.ett.update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
+            ENDPOINT_CANARY("Updating Sketch With", update.edge.src, update.edge.dst);
+        }
+
+        // Prepare greedy batch size messages
+        GreedyRefreshMessage this_sizes;
+        this_sizes.size1 = roots.root1->size;
+        this_sizes.size2 = roots.root2->size;
+        tier.this_sizes_buffer[i] = this_sizes;
+        // Exchange every full chunk of sizes with the tiers around this node while the rest of the batch is sampled
+        if (lowest) {
+            sizes_ready.store(i+1, std::memory_order_release);
+            if (pool.get_num_workers() == 0)
+                exchange_ready_sizes(num_updates);
+        }
+
+        // An unchanged root keeps the non-isolated status it had before the update
+        if (roots.root_unchanged) {
+            tier.query_result_buffer[2*i] = ZERO;
+            tier.query_result_buffer[2*i+1] = ZERO;
             continue;
-        // First undo all the sketch updates we did after isolated update
-        for (uint32_t update_idx = minimum_isolated_update; update_idx < num_updates+1; update_idx++) {
-            GraphUpdate update = update_buffer[update_idx].update;
-            edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
-            // There could be a cut on a later update that needs to be rolled back
-            unlikely_if (split_revert_buffer[update_idx-1]) {
-                ett.link(update.edge.src, update.edge.dst);
-            }
-            ett.update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
-        }
-        // ======================================================================================
-        // =========================== PROCESS THE ISOLATED UPDATES ===============+=============
-        // ======================================================================================
-        int end_update_idx = using_sliding_window ? minimum_isolated_update+1 : num_updates+1;
-        for (int update_idx = minimum_isolated_update; update_idx < end_update_idx; update_idx++) {
-            GraphUpdate update = update_buffer[update_idx].update;
-            edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
-            unlikely_if (update.type == DELETE && ett.has_edge(update.edge.src, update.edge.dst)) {
-                ett.cut(update.edge.src, update.edge.dst);
+        }
+        uint32_t last_staged = staged ? num_updates : 0;
+        Sketch* ett_agg = get_staged_aggregate(tier, update.edge.src, update_idx+1, last_staged);
+        ett_agg->reset_sample_state();
+        tier.query_result_buffer[2*i] = ett_agg->sample().result;
+        ett_agg = get_staged_aggregate(tier, update.edge.dst, update_idx+1, last_staged);
+        ett_agg->reset_sample_state();
+        tier.query_result_buffer[2*i+1] = ett_agg->sample().result;
+    }
+    tier.staged_roots_valid = false;
+}
+
+void TierNode::exchange_ready_sizes(uint32_t num_updates) {
+    uint32_t ready = sizes_ready.load(std::memory_order_acquire);
+    while (ready - sizes_sent >= size_message_chunk || (ready == num_updates && sizes_sent < ready)) {
+        uint32_t last = std::min(sizes_sent + size_message_chunk, ready);
+        exchange_sizes(sizes_sent, last);
+        sizes_sent = last;
+    }
+}
+
+void TierNode::exchange_sizes(uint32_t first, uint32_t last) {
+    // The ends of the chain have no rank below or above, their side of the exchange is empty
+    TierState& bottom = *tiers.front();
+    TierState& top = *tiers.back();
+    for (uint32_t i = first; i < last; i += size_message_chunk) {
+        uint32_t count = std::min(size_message_chunk, last-i);
+        size_requests.push_back(chain_comm->ineighbor_alltoall(&bottom.this_sizes_buffer[i], &top.next_sizes_buffer[i],
+            count*sizeof(GreedyRefreshMessage)));
+    }
+}
+
+void TierNode::refresh_update(uint32_t update_idx, uint32_t last_staged) {
+    uint32_t first_staged = update_idx+1;
+    uint32_t start_tier = 0;
+    // Refresh message passed between consecutive tiers hosted by this node
+    RefreshMessage local_message;
+    // Start the refreshing sequence
+    START(normal_refresh_timer);
+    for (uint32_t tier_num = start_tier; tier_num < num_tiers; tier_num++) {
+        auto tier_start = std::chrono::steady_clock::now();
+        int rank = placement.rank_of(tier_num);
+        // If this node hosts the current tier process the refresh message from previous tier or input node
+        if (rank == world_rank) {
+            TierState& tier = local_tier(tier_num);
+            RefreshMessage refresh_message = local_message;
+            if (tier_num == start_tier || !hosts(tier_num-1)) {
+                int source = (tier_num == start_tier) ? 0 : placement.rank_of(tier_num-1);
+                auto wait_start = std::chrono::steady_clock::now();
+                comm->recv(&refresh_message, sizeof(RefreshMessage), source, 0);
+                tier.refresh_idle_time += microseconds_since(wait_start);
             }
-            ett.update_sketches(update.edge.src, update.edge.dst, (vec_t)edge);
-            uint32_t start_tier = 0;
-            // Start the refreshing sequence
-            START(normal_refresh_timer);
-            for (uint32_t tier = start_tier; tier < num_tiers; tier++) {
-                int rank = tier + 1;
-                // If this node's tier is the current tier process the refresh message from previous tier or input node
-                if (tier == tier_num) {
-                    RefreshMessage refresh_message;
-                    int source = (tier == start_tier) ? 0 : tier_num;
-                    MPI_Recv(&refresh_message, sizeof(RefreshMessage), MPI_BYTE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                    if (tier != 0)
-                        refresh_tier(refresh_message);
-                    // Send a refresh message to the next tier
-                    if (tier < num_tiers-1) {
-                        RefreshEndpoint e1, e2;
-                        e1.v = refresh_message.endpoints.first.v;
-                        e2.v = refresh_message.endpoints.second.v;
-                        for (RefreshEndpoint* e : {&e1, &e2}) {
-                            e->prev_tier_size = ett.get_size(e->v);
-                            SkipListNode* root = ett.get_root(e->v);
-                            root->process_updates();
-                            Sketch* ett_agg = root->sketch_agg;
-                            ett_agg->reset_sample_state();
-                            e->sketch_query_result = ett_agg->sample();
-                        }
-                        RefreshMessage next_refresh_message;
-                        next_refresh_message.endpoints = {e1, e2};
-                        MPI_Send(&next_refresh_message, sizeof(RefreshMessage), MPI_BYTE, rank+1, 0, MPI_COMM_WORLD);
-                    }
-                    continue;
-                }
-                // For every other tier just receive and perform update messages
-                if (tier != 0)
-                for (int endpoint : {0,1}) {
-                    std::ignore = endpoint;
-                    // Receive a broadcast to see if the endpoint at the current tier is isolated or not
-                    EttUpdateMessage update_message;
-                    bcast(&update_message, sizeof(EttUpdateMessage), rank);
-                    if (update_message.type == NOT_ISOLATED) continue;
-                    // Get the two broadcasts and perform ett updates
-                    for (int broadcast : {0,1}) {
-                        std::ignore = broadcast;
-                        EttUpdateMessage update_message;
-                        bcast(&update_message, sizeof(EttUpdateMessage), rank);
-                        ett_update_tier(update_message);
-                        if (update_message.type == LINK) break;
-                    }
+            if (tier_num != 0)
+                refresh_tier(tier, refresh_message);
+            // Send a refresh message to the next tier
+            if (tier_num < num_tiers-1) {
+                RefreshEndpoint e1, e2;
+                e1.v = refresh_message.endpoints.first.v;
+                e2.v = refresh_message.endpoints.second.v;
+                for (RefreshEndpoint* e : {&e1, &e2}) {
+                    e->prev_tier_size = tier.ett.get_size(e->v);
+                    Sketch* ett_agg = get_staged_aggregate(tier, e->v, first_staged, last_staged);
+                    ett_agg->reset_sample_state();
+                    SketchSample sample = ett_agg->sample();
+                    e->sample_idx = sample.idx;
+                    e->sample_result = sample.result;
                 }
+                local_message.endpoints = {e1, e2};
+                if (!hosts(tier_num+1))
+                    comm->send(&local_message, sizeof(RefreshMessage), placement.rank_of(tier_num+1), 0);
+            }
+            // The other hosted tiers wait while this one is refreshed
+            long tier_time = microseconds_since(tier_start);
+            for (auto& other : tiers)
+                if (other.get() != &tier)
+                    other->refresh_idle_time += tier_time;
+            continue;
+        }
+        // For tiers on other nodes just receive and perform update messages
+        if (tier_num != 0)
+        for (int endpoint : {0,1}) {
+            std::ignore = endpoint;
+            // Receive a broadcast to see if the endpoint at the current tier is isolated or not
+            EttUpdateMessage update_message;
+            comm->bcast(&update_message, sizeof(EttUpdateMessage), rank);
+            if (update_message.type == NOT_ISOLATED) continue;
+            // Get the cut and link of the refresh step and perform the ett updates
+            EttRefreshStepMessage step_message;
+            comm->bcast(&step_message, sizeof(EttRefreshStepMessage), rank);
+            apply_refresh_step(step_message);
+        }
+        long tier_time = microseconds_since(tier_start);
+        for (auto& hosted : tiers)
+            hosted->refresh_idle_time += tier_time;
+    }
+    STOP(normal_refresh_time, normal_refresh_timer);
+}
+
+void TierNode::refresh_updates(uint32_t* update_idxs, uint32_t num_refreshes, uint32_t last_staged) {
+    std::vector<RefreshMessage> refresh_messages(num_refreshes);
+    std::vector<EttUpdateMessage> update_messages(num_refreshes);
+    std::vector<EttRefreshStepMessage> step_messages(num_refreshes);
+    // Same sequence as refresh_update, but every message carries one entry per update
+    START(normal_refresh_timer);
+    for (uint32_t tier_num = 0; tier_num < num_tiers; tier_num++) {
+        auto tier_start = std::chrono::steady_clock::now();
+        int rank = placement.rank_of(tier_num);
+        if (rank == world_rank) {
+            TierState& tier = local_tier(tier_num);
+            // Between tiers hosted by this node the messages stay in refresh_messages
+            if (tier_num == 0 || !hosts(tier_num-1)) {
+                int source = (tier_num == 0) ? 0 : placement.rank_of(tier_num-1);
+                auto wait_start = std::chrono::steady_clock::now();
+                comm->recv(refresh_messages.data(), sizeof(RefreshMessage)*num_refreshes, source, 0);
+                tier.refresh_idle_time += microseconds_since(wait_start);
+            }
+            if (tier_num != 0)
+                refresh_tier(tier, refresh_messages.data(), num_refreshes);
+            if (tier_num < num_tiers-1) {
+                // The updates are in different components so each one is sampled with only its own staged suffix
+                for (uint32_t r = 0; r < num_refreshes; r++)
+                    sample_endpoints(tier, refresh_messages[r], update_idxs[r]+1, last_staged);
+                if (!hosts(tier_num+1))
+                    comm->send(refresh_messages.data(), sizeof(RefreshMessage)*num_refreshes, placement.rank_of(tier_num+1), 0);
+            }
+            // The other hosted tiers wait while this one is refreshed
+            long tier_time = microseconds_since(tier_start);
+            for (auto& other : tiers)
+                if (other.get() != &tier)
+                    other->refresh_idle_time += tier_time;
+            continue;
+        }
+        if (tier_num != 0)
+        for (int endpoint : {0,1}) {
+            std::ignore = endpoint;
+            comm->bcast(update_messages.data(), sizeof(EttUpdateMessage)*num_refreshes, rank);
+            if (std::none_of(update_messages.begin(), update_messages.end(),
+                    [](EttUpdateMessage& m){return m.type == ISOLATED;}))
+                continue;
+            // Receive the cut and link for every update
+            comm->bcast(step_messages.data(), sizeof(EttRefreshStepMessage)*num_refreshes, rank);
+            for (EttRefreshStepMessage& step_message : step_messages) {
+                apply_refresh_step(step_message);
             }
-            STOP(normal_refresh_time, normal_refresh_timer);
         }
+        long tier_time = microseconds_since(tier_start);
+        for (auto& hosted : tiers)
+            hosted->refresh_idle_time += tier_time;
     }
+    STOP(normal_refresh_time, normal_refresh_timer);
 }
 
-void TierNode::ett_update_tier(EttUpdateMessage message) {
-    if (message.type == LINK && tier_num >= message.start_tier) {
-        ett.link(message.endpoint1, message.endpoint2);
-        ENDPOINT_CANARY("Linking ETT With", message.endpoint1, message.endpoint2);
-    } else if (message.type == CUT && tier_num >= message.start_tier) {
-        ett.cut(message.endpoint1, message.endpoint2);
-        ENDPOINT_CANARY("Cutting ETT With", message.endpoint1, message.endpoint2);
+void TierNode::sample_endpoints(TierState& tier, RefreshMessage& message, uint32_t first_staged, uint32_t last_staged) {
+    for (RefreshEndpoint* e : {&message.endpoints.first, &message.endpoints.second}) {
+        e->prev_tier_size = tier.ett.get_size(e->v);
+        Sketch* ett_agg = get_staged_aggregate(tier, e->v, first_staged, last_staged);
+        ett_agg->reset_sample_state();
+        SketchSample sample = ett_agg->sample();
+        e->sample_idx = sample.idx;
+        e->sample_result = sample.result;
     }
 }
 
-void TierNode::refresh_tier(RefreshMessage message) {
+void TierNode::cache_staged_roots(TierState& tier, uint32_t first_staged, uint32_t last_staged) {
+    // Roots only change when the forest does so they stay valid until the next cut
+    for (uint32_t update_idx = first_staged; update_idx <= last_staged; update_idx++) {
+        GraphUpdate update = update_buffer[update_idx];
+        tier.staged_roots[update_idx] = {tier.ett.get_root(update.edge.src), tier.ett.get_root(update.edge.dst)};
+    }
+    tier.staged_roots_valid = true;
+}
+
+Sketch* TierNode::get_staged_aggregate(TierState& tier, node_id_t v, uint32_t first_staged, uint32_t last_staged) {
+    // v is an endpoint of a refreshed update, the greedy check applied its sketch update before
+    SkipListNode* root = tier.ett.get_root(v);
+    assert(root != nullptr);
+    root->process_updates();
+    // Sketches are linear so only staged edges with exactly one endpoint in this tree changed its aggregate
+    bool copied = false;
+    for (uint32_t update_idx = first_staged; update_idx <= last_staged; update_idx++) {
+        GraphUpdate update = update_buffer[update_idx];
+        std::pair<SkipListNode*, SkipListNode*> roots = tier.staged_roots_valid ? tier.staged_roots[update_idx]
+            : std::make_pair(tier.ett.get_root(update.edge.src), tier.ett.get_root(update.edge.dst));
+        if ((roots.first == root) == (roots.second == root))
+            continue;
+        if (!copied) {
+            tier.staged_sketch->zero_contents();
+            tier.staged_sketch->merge(*root->sketch_agg);
+            copied = true;
+        }
+        edge_id_t edge = VERTICES_TO_EDGE(update.edge.src, update.edge.dst);
+        tier.staged_sketch->update((vec_t)edge);
+    }
+    return copied ? tier.staged_sketch : root->sketch_agg;
+}
+
+void TierNode::cut_replica(uint32_t first_update, uint32_t num_updates) {
+    // Same speculative cuts as the input node makes to its forest
+    for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++) {
+        GraphUpdate update = update_buffer[update_idx];
+        lct_revert_buffer[update_idx-1] = MAX_INT;
+        unlikely_if (update.type == DELETE && lct_replica->has_edge(update.edge.src, update.edge.dst)) {
+            lct_revert_buffer[update_idx-1] = lct_replica->get_edge_weight(update.edge.src, update.edge.dst);
+            lct_replica->cut(update.edge.src, update.edge.dst);
+        }
+    }
+}
+
+void TierNode::relink_replica(uint32_t first_update, uint32_t num_updates) {
+    for (uint32_t update_idx = first_update; update_idx < num_updates+1; update_idx++) {
+        GraphUpdate update = update_buffer[update_idx];
+        unlikely_if (lct_revert_buffer[update_idx-1] != MAX_INT)
+            lct_replica->link(update.edge.src, update.edge.dst, lct_revert_buffer[update_idx-1]);
+    }
+}
+
+void TierNode::query_cycles(EttUpdateMessage* update_messages, LctResponseMessage* responses, uint32_t num_queries) {
+    if (!lct_replica) {
+        comm->recv(responses, sizeof(LctResponseMessage)*num_queries, 0, 0);
+        return;
+    }
+    // The replica has seen the same cuts and links as the input node, so it gives the same answers
+    for (uint32_t i = 0; i < num_queries; i++) {
+        if (update_messages[i].type == NOT_ISOLATED)
+            continue;
+        PathMaxResult max = lct_replica->connected_path_max(update_messages[i].endpoint1, update_messages[i].endpoint2);
+        responses[i].connected = max.connected;
+        responses[i].cycle_edge = max.max_edge;
+        responses[i].weight = max.weight;
+    }
+}
+
+void TierNode::apply_refresh_step(EttRefreshStepMessage message) {
+    ett_update_tiers(message.cut);
+    ett_update_tiers(message.link);
+    if (!lct_replica)
+        return;
+    if (message.cut.type == CUT)
+        lct_replica->cut(message.cut.endpoint1, message.cut.endpoint2);
+    if (message.link.type == LINK)
+        lct_replica->link(message.link.endpoint1, message.link.endpoint2, message.link.start_tier);
+}
+
+void TierNode::ett_update_tiers(EttUpdateMessage message) {
+    for (auto& tier : tiers) {
+        if (message.type == LINK && tier->tier_num >= message.start_tier) {
+            tier->ett.link(message.endpoint1, message.endpoint2);
+            ENDPOINT_CANARY("Linking ETT With", message.endpoint1, message.endpoint2);
+        } else if (message.type == CUT && tier->tier_num >= message.start_tier) {
+            tier->ett.cut(message.endpoint1, message.endpoint2);
+            ENDPOINT_CANARY("Cutting ETT With", message.endpoint1, message.endpoint2);
+        }
+    }
+}
+
+void TierNode::refresh_tier(TierState& tier, RefreshMessage message) {
     for (RefreshEndpoint endpoint: {message.endpoints.first, message.endpoints.second}) {
         // Check if the tree containing this endpoint is isolated
         uint32_t prev_tier_size = endpoint.prev_tier_size;
-        uint32_t this_tier_size = ett.get_size(endpoint.v);
+        uint32_t this_tier_size = tier.ett.get_size(endpoint.v);
         
-        node_id_t a = (node_id_t)endpoint.sketch_query_result.idx;
-        node_id_t b = (node_id_t)(endpoint.sketch_query_result.idx>>32);
+        node_id_t a = (node_id_t)endpoint.sample_idx;
+        node_id_t b = (node_id_t)(endpoint.sample_idx>>32);
         
         // Tell all other nodes an isolation was found
         EttUpdateMessage update_message;
-        update_message.type = (TreeOperationType)(!(prev_tier_size != this_tier_size || endpoint.sketch_query_result.result != GOOD));
+        update_message.type = (TreeOperationType)(!(prev_tier_size != this_tier_size || endpoint.sample_result != GOOD));
         update_message.endpoint1 = a;
         update_message.endpoint2 = b;
-        bcast(&update_message, sizeof(EttUpdateMessage), tier_num+1);
+        comm->bcast(&update_message, sizeof(EttUpdateMessage), world_rank);
 				
         if (update_message.type == NOT_ISOLATED)
             continue;
 				
         // Query LCT node to check if this new edge forms a cycle
         LctResponseMessage lct_response;
-        MPI_Recv(&lct_response, sizeof(LctResponseMessage), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        auto lct_wait_start = std::chrono::steady_clock::now();
+        query_cycles(&update_message, &lct_response, 1);
+        tier.refresh_idle_time += microseconds_since(lct_wait_start);
 
-        // If there is a cycle formed, tell all necessary nodes to delete that edge
+        // Tell all nodes to delete the cycle edge if there is one, and to add the new edge
+        // on the current tier and above, in one broadcast
+        EttRefreshStepMessage step_message;
         if (lct_response.connected) {
-            node_id_t c = (node_id_t)lct_response.cycle_edge;
-            node_id_t d = (node_id_t)(lct_response.cycle_edge>>32);
-
-            EttUpdateMessage cut_message;
-            cut_message.type = CUT;
-            cut_message.endpoint1 = c;
-            cut_message.endpoint2 = d;
-            cut_message.start_tier = lct_response.weight;
-            bcast(&cut_message, sizeof(EttUpdateMessage), tier_num+1);
-
-            if (tier_num >= lct_response.weight) {
-                ett.cut(c,d);
-                ENDPOINT_CANARY("Cutting ETT With", c, d);
-            }
+            step_message.cut.type = CUT;
+            step_message.cut.endpoint1 = (node_id_t)lct_response.cycle_edge;
+            step_message.cut.endpoint2 = (node_id_t)(lct_response.cycle_edge>>32);
+            step_message.cut.start_tier = lct_response.weight;
         }
+        step_message.link.type = LINK;
+        step_message.link.endpoint1 = a;
+        step_message.link.endpoint2 = b;
+        step_message.link.start_tier = tier.tier_num;
+        comm->bcast(&step_message, sizeof(EttRefreshStepMessage), world_rank);
+        apply_refresh_step(step_message);
+    }
+}
 
-        // Tell all nodes above and including the current tier to add the new edge
-        EttUpdateMessage link_message;
-        link_message.type = LINK;
-        link_message.endpoint1 = a;
-        link_message.endpoint2 = b;
-        link_message.start_tier = tier_num;
-        bcast(&link_message, sizeof(EttUpdateMessage), tier_num+1);
-        ett.link(a,b);
-        ENDPOINT_CANARY("Linking ETT With", a, b);
+void TierNode::refresh_tier(TierState& tier, RefreshMessage* messages, uint32_t num_refreshes) {
+    std::vector<EttUpdateMessage> update_messages(num_refreshes);
+    std::vector<LctResponseMessage> lct_responses(num_refreshes);
+    for (int endpoint : {0,1}) {
+        // Check the trees containing this endpoint of every update
+        bool any_isolated = false;
+        for (uint32_t r = 0; r < num_refreshes; r++) {
+            RefreshEndpoint e = endpoint ? messages[r].endpoints.second : messages[r].endpoints.first;
+            bool isolated = e.prev_tier_size == tier.ett.get_size(e.v) && e.sample_result == GOOD;
+            update_messages[r].type = isolated ? ISOLATED : NOT_ISOLATED;
+            update_messages[r].endpoint1 = (node_id_t)e.sample_idx;
+            update_messages[r].endpoint2 = (node_id_t)(e.sample_idx>>32);
+            any_isolated |= isolated;
+        }
+        comm->bcast(update_messages.data(), sizeof(EttUpdateMessage)*num_refreshes, world_rank);
+        if (!any_isolated)
+            continue;
+        // The LCT node answers the cycle query of every isolated endpoint at once
+        auto lct_wait_start = std::chrono::steady_clock::now();
+        query_cycles(update_messages.data(), lct_responses.data(), num_refreshes);
+        tier.refresh_idle_time += microseconds_since(lct_wait_start);
+
+        std::vector<EttRefreshStepMessage> step_messages(num_refreshes);
+        for (uint32_t r = 0; r < num_refreshes; r++) {
+            if (update_messages[r].type == NOT_ISOLATED)
+                continue;
+            if (lct_responses[r].connected) {
+                step_messages[r].cut.type = CUT;
+                step_messages[r].cut.endpoint1 = (node_id_t)lct_responses[r].cycle_edge;
+                step_messages[r].cut.endpoint2 = (node_id_t)(lct_responses[r].cycle_edge>>32);
+                step_messages[r].cut.start_tier = lct_responses[r].weight;
+            }
+            step_messages[r].link.type = LINK;
+            step_messages[r].link.endpoint1 = update_messages[r].endpoint1;
+            step_messages[r].link.endpoint2 = update_messages[r].endpoint2;
+            step_messages[r].link.start_tier = tier.tier_num;
+        }
+        comm->bcast(step_messages.data(), sizeof(EttRefreshStepMessage)*num_refreshes, world_rank);
+        for (EttRefreshStepMessage& step_message : step_messages) {
+            apply_refresh_step(step_message);
+        }
     }
 }
@@ -0,0 +1,29 @@
+#include <cassert>
+
+#include "../include/tier_placement.h"
+
+
+TierPlacement::TierPlacement(uint32_t num_tiers, uint32_t num_ranks) : num_tiers(num_tiers), num_ranks(num_ranks) {
+    assert(num_ranks > 0 && num_ranks <= num_tiers);
+    base_tiers = num_tiers / num_ranks;
+    split_rank = num_ranks - num_tiers % num_ranks;
+}
+
+int TierPlacement::rank_of(uint32_t tier) {
+    assert(tier < num_tiers);
+    uint32_t split_tier = split_rank * base_tiers;
+    if (tier < split_tier)
+        return tier / base_tiers + 1;
+    return split_rank + (tier - split_tier) / (base_tiers + 1) + 1;
+}
+
+uint32_t TierPlacement::first_tier(int rank) {
+    assert(rank > 0 && (uint32_t)rank <= num_ranks);
+    uint32_t r = rank - 1;
+    return r * base_tiers + (r > split_rank ? r - split_rank : 0);
+}
+
+uint32_t TierPlacement::num_tiers_on(int rank) {
+    assert(rank > 0 && (uint32_t)rank <= num_ranks);
+    return (uint32_t)(rank - 1) < split_rank ? base_tiers : base_tiers + 1;
+}
@@ -0,0 +1,105 @@
+#include "../include/tier_thread_pool.h"
+#include <omp.h>
+
+// Number of empty polls of its queues before a worker goes to sleep
+#define WORKER_SPIN_LIMIT 4096
+
+bool TierJobQueue::push(TierJob* job) {
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	if (t - head.load(std::memory_order_acquire) == capacity)
+		return false;
+	jobs[t % capacity] = job;
+	tail.store(t+1, std::memory_order_release);
+	return true;
+}
+
+bool TierJobQueue::pop(TierJob*& job) {
+	uint32_t h = head.load(std::memory_order_relaxed);
+	if (h == tail.load(std::memory_order_acquire))
+		return false;
+	job = jobs[h % capacity];
+	head.store(h+1, std::memory_order_release);
+	return true;
+}
+
+TierThreadPool::TierThreadPool(uint32_t num_tiers, uint32_t num_threads) : num_tiers(num_tiers), queues(num_tiers) {
+	if (num_threads == 0)
+		num_threads = omp_get_max_threads();
+	num_workers = std::min(num_threads, num_tiers);
+	// With a single thread all tier work is done inline by the caller
+	if (num_workers <= 1) {
+		num_workers = 0;
+		return;
+	}
+	for (uint32_t i = 0; i < num_workers; i++)
+		workers.emplace_back(&TierThreadPool::worker_main, this, i);
+}
+
+TierThreadPool::~TierThreadPool() {
+	stop = true;
+	{
+		std::lock_guard<std::mutex> lk(sleep_lock);
+		sleep_cv.notify_all();
+	}
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void TierThreadPool::wake_workers() {
+	epoch.fetch_add(1);
+	if (sleepers.load() > 0) {
+		std::lock_guard<std::mutex> lk(sleep_lock);
+		sleep_cv.notify_all();
+	}
+}
+
+void TierThreadPool::worker_main(uint32_t worker_id) {
+	uint32_t idle_polls = 0;
+	while (!stop.load(std::memory_order_relaxed)) {
+		uint64_t seen_epoch = epoch.load();
+		bool found = false;
+		for (uint32_t tier = worker_id; tier < num_tiers; tier += num_workers) {
+			TierJob* job;
+			if (queues[tier].pop(job)) {
+				job->func(tier);
+				job->remaining.fetch_sub(1, std::memory_order_release);
+				found = true;
+			}
+		}
+		if (found) {
+			idle_polls = 0;
+			continue;
+		}
+		if (++idle_polls < WORKER_SPIN_LIMIT)
+			continue;
+		// Sleep until new work is published
+		std::unique_lock<std::mutex> lk(sleep_lock);
+		sleepers.fetch_add(1);
+		sleep_cv.wait(lk, [&]{ return epoch.load() != seen_epoch || stop.load(); });
+		sleepers.fetch_sub(1);
+		idle_polls = 0;
+	}
+}
+
+void TierThreadPool::for_tiers(uint32_t first, uint32_t last, std::function<void(uint32_t)> func,
+    std::function<void()> poll) {
+	if (first >= last)
+		return;
+	if (num_workers == 0) {
+		for (uint32_t tier = first; tier < last; tier++)
+			func(tier);
+		return;
+	}
+	TierJob job;
+	job.func = std::move(func);
+	job.remaining.store(last-first, std::memory_order_relaxed);
+	for (uint32_t tier = first; tier < last; tier++)
+		while (!queues[tier].push(&job))
+			std::this_thread::yield();
+	wake_workers();
+	while (job.remaining.load(std::memory_order_acquire) != 0) {
+		if (poll)
+			poll();
+		std::this_thread::yield();
+	}
+}
@@ -0,0 +1,95 @@
+#include <cassert>
+#include <cstring>
+
+#include "wire_format.h"
+
+
+static inline uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static inline uint32_t varint_size(uint64_t value) {
+    uint32_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline uint8_t* write_varint(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static inline const uint8_t* read_varint(const uint8_t* in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return in;
+    }
+}
+
+uint32_t encode_updates(const GraphUpdate* updates, uint32_t num_updates, uint8_t* out, uint8_t& flags) {
+    // Size the varint encoding first and only use it when it beats the fixed one
+    uint32_t varint_bytes = 0;
+    node_id_t prev_src = 0;
+    for (uint32_t i = 0; i < num_updates; i++) {
+        Edge edge = updates[i].edge;
+        varint_bytes += varint_size(zigzag((int64_t)edge.src - prev_src) << 1);
+        varint_bytes += varint_size(zigzag((int64_t)edge.dst - edge.src));
+        prev_src = edge.src;
+    }
+    if (varint_bytes < max_payload_bytes(num_updates)) {
+        flags |= BATCH_VARINT;
+        uint8_t* curr = out;
+        prev_src = 0;
+        for (uint32_t i = 0; i < num_updates; i++) {
+            Edge edge = updates[i].edge;
+            curr = write_varint(curr, zigzag((int64_t)edge.src - prev_src) << 1 | (updates[i].type == DELETE));
+            curr = write_varint(curr, zigzag((int64_t)edge.dst - edge.src));
+            prev_src = edge.src;
+        }
+        return varint_bytes;
+    }
+    for (uint32_t i = 0; i < num_updates; i++) {
+        Edge edge = updates[i].edge;
+        assert(edge.src < (1u << 31) && edge.dst < (1u << 31));
+        uint32_t words[2] = {edge.src | (uint32_t)(updates[i].type == DELETE) << 31, edge.dst};
+        memcpy(out + 8*i, words, 8);
+    }
+    return max_payload_bytes(num_updates);
+}
+
+void decode_updates(const uint8_t* in, uint32_t num_updates, uint8_t flags, GraphUpdate* updates) {
+    if (flags & BATCH_VARINT) {
+        node_id_t prev_src = 0;
+        for (uint32_t i = 0; i < num_updates; i++) {
+            uint64_t src_word, dst_word;
+            in = read_varint(in, src_word);
+            in = read_varint(in, dst_word);
+            updates[i].type = (src_word & 1) ? DELETE : INSERT;
+            updates[i].edge.src = (node_id_t)(prev_src + unzigzag(src_word >> 1));
+            updates[i].edge.dst = (node_id_t)(updates[i].edge.src + unzigzag(dst_word));
+            prev_src = updates[i].edge.src;
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < num_updates; i++) {
+        uint32_t words[2];
+        memcpy(words, in + 8*i, 8);
+        updates[i].type = (words[0] >> 31) ? DELETE : INSERT;
+        updates[i].edge.src = words[0] & ~(1u << 31);
+        updates[i].edge.dst = words[1];
+    }
+}
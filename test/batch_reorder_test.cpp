@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "batch_reorder.h"
+
+TEST(BatchReorderSuite, forest_deletions_go_last) {
+    DynamicTree forest(10);
+    forest.link(1, 2, 1);
+    forest.link(2, 3, 2);
+    std::vector<GraphUpdate> batch = {
+        {{4, 5}, INSERT},
+        {{1, 2}, DELETE},  // forest edge, it and every later update to it are deferred
+        {{6, 7}, INSERT},
+        {{2, 1}, INSERT},  // the same edge inserted again
+        {{8, 9}, DELETE},  // not a forest edge
+        {{1, 2}, DELETE},  // deleted a second time
+        {{3, 2}, DELETE},  // another forest edge
+        {{3, 4}, INSERT},
+    };
+    std::vector<GraphUpdate> reordered = batch;
+    uint32_t kept_updates = reorder_batch(reordered.data(), reordered.size(), forest);
+    // The updates that cannot disconnect the forest keep their order in front, then the deferred ones in theirs
+    std::vector<uint32_t> expected_order = {0, 2, 4, 7, 1, 3, 5, 6};
+    ASSERT_EQ(kept_updates, 4);
+    for (uint32_t i = 0; i < batch.size(); i++) {
+        GraphUpdate expected = batch[expected_order[i]];
+        ASSERT_EQ(reordered[i].edge.src, expected.edge.src) << "Update " << i;
+        ASSERT_EQ(reordered[i].edge.dst, expected.edge.dst) << "Update " << i;
+        ASSERT_EQ(reordered[i].type, expected.type) << "Update " << i;
+    }
+    // Reordering only looks at the forest
+    ASSERT_TRUE(forest.has_edge(1, 2));
+    ASSERT_TRUE(forest.has_edge(2, 3));
+}
+
+TEST(BatchReorderSuite, no_forest_deletions) {
+    DynamicTree forest(10);
+    forest.link(1, 2, 1);
+    std::vector<GraphUpdate> batch = {{{1, 3}, DELETE}, {{1, 2}, INSERT}, {{5, 6}, INSERT}};
+    std::vector<GraphUpdate> reordered = batch;
+    ASSERT_EQ(reorder_batch(reordered.data(), reordered.size(), forest), batch.size());
+    for (uint32_t i = 0; i < batch.size(); i++) {
+        ASSERT_EQ(reordered[i].edge.src, batch[i].edge.src);
+        ASSERT_EQ(reordered[i].edge.dst, batch[i].edge.dst);
+    }
+}
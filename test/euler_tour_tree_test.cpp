@@ -11,6 +11,8 @@ bool EulerTourNode::isvalid() const {
   // validate allowed_caller is null iff edges is empty
   EXPECT_EQ(allowed_caller == nullptr, this->edges.empty()) << (invalid = true, "");
   if (invalid) return false;
+  // an untouched node has no skiplist at all
+  if (!this->is_touched()) return true;
   // make sure allowed_caller corresponds to one of the nodes
   bool allowed_valid = false;
   // validate each edge
@@ -208,3 +210,127 @@ TEST(EulerTourTreeSuite, get_aggregate) {
   Sketch* aggregate = ett.get_aggregate(0);
   ASSERT_TRUE(*aggregate == true_aggregate);
 }
+
+TEST(EulerTourTreeSuite, untouched_vertices) {
+  // Sketch variables
+  sketch_len = 1000;
+  sketch_err = 4;
+
+  int nodecount = 1000;
+  int seed = time(NULL);
+  EulerTourTree ett(nodecount, 0, seed);
+
+  // Nothing is built until a vertex is touched, but it still acts as a singleton
+  for (int i = 0; i < nodecount; i++) {
+    ASSERT_FALSE(ett.ett_nodes[i].is_touched());
+    ASSERT_EQ(ett.get_root(i), nullptr);
+    ASSERT_EQ(ett.get_size(i), 2);
+    ASSERT_EQ(ett.ett_nodes[i].get_component().size(), 1);
+  }
+  // Cutting an untouched vertex is a no-op
+  ett.cut(0, 1);
+  ASSERT_FALSE(ett.ett_nodes[0].is_touched());
+
+  // Sizes of touched vertices match the implicit singleton size
+  ett.update_sketch(2, (vec_t)2);
+  ASSERT_TRUE(ett.ett_nodes[2].is_touched());
+  ASSERT_EQ(ett.get_size(2), ett.get_size(3));
+
+  // Linking touches both endpoints
+  ett.link(4, 5);
+  ASSERT_TRUE(ett.ett_nodes[4].is_touched() && ett.ett_nodes[5].is_touched());
+  ASSERT_EQ(ett.get_root(4), ett.get_root(5));
+  ASSERT_EQ(ett.get_size(4), 4);
+  ASSERT_TRUE(ett.ett_nodes[4].isvalid() && ett.ett_nodes[5].isvalid());
+}
+
+TEST(EulerTourTreeSuite, update_sketches_unchanged_root) {
+  // Sketch variables
+  sketch_len = 1000;
+  sketch_err = 4;
+
+  int nodecount = 100;
+  int seed = time(NULL);
+  EulerTourTree ett(nodecount, 0, seed);
+  for (int i = 0; i < nodecount/2-1; i++)
+    ett.link(i, i+1);
+
+  // Endpoints in different trees change both root aggregates
+  SketchUpdateResult result = ett.update_sketches(0, nodecount-1, (vec_t)1);
+  ASSERT_FALSE(result.root_unchanged);
+  ASSERT_EQ(result.root1, ett.get_root(0));
+  ASSERT_EQ(result.root2, ett.get_root(nodecount-1));
+
+  Sketch true_aggregate(sketch_len, seed, 1, sketch_err);
+  true_aggregate.update((vec_t)1);
+
+  // Endpoints in the same tree cancel below the root and leave it unchanged
+  for (int i = 1; i < nodecount/2; i++) {
+    result = ett.update_sketches(0, i, (vec_t)(i+1));
+    ASSERT_TRUE(result.root_unchanged);
+    ASSERT_EQ(result.root1, ett.get_root(0));
+    ASSERT_EQ(result.root1, result.root2);
+  }
+  SkipListNode* root = ett.get_root(0);
+  root->process_updates();
+  ASSERT_TRUE(*root->sketch_agg == true_aggregate);
+}
+
+TEST(EulerTourTreeSuite, shared_tier_aggregates) {
+  // Sketch variables
+  sketch_len = 1000;
+  sketch_err = 4;
+
+  int nodecount = 200;
+  int seed = time(NULL);
+  srand(seed);
+  std::cout << "Seeding shared tier test with " << seed << std::endl;
+  // The shared tiers of ett must match trees of their own with the same forest
+  EulerTourTree ett(nodecount, 0, seed);
+  EulerTourTree own1(nodecount, 1, seed+1);
+  EulerTourTree own2(nodecount, 2, seed+2);
+  ett.add_shared_tier(seed+1);
+  for (int i = 0; i < nodecount; i++) {
+    ett.update_sketch(i, (vec_t)i);
+    own1.update_sketch(i, (vec_t)i);
+    own2.update_sketch(i, (vec_t)i);
+  }
+  auto check_root = [&](node_id_t v) {
+    SkipListNode* root = ett.get_root(v);
+    root->process_updates();
+    SkipListNode* own_root = own1.get_root(v);
+    own_root->process_updates();
+    ASSERT_TRUE(*root->shared_aggs[0] == *own_root->sketch_agg);
+    if (ett.num_shared_tiers() == 2) {
+      own_root = own2.get_root(v);
+      own_root->process_updates();
+      ASSERT_TRUE(*root->shared_aggs[1] == *own_root->sketch_agg);
+    }
+  };
+  for (int i = 0; i < 20*nodecount; i++) {
+    node_id_t a = rand() % nodecount, b = rand() % nodecount;
+    if (a == b) continue;
+    // Halfway through add a second shared tier from the vertex sketches of its own tree
+    if (i == 10*nodecount) {
+      ett.add_shared_tier(seed+2);
+      for (int v = 0; v < nodecount; v++)
+        ett.merge_shared_sketch(1, v, own2.get_vertex_sketch(v));
+    }
+    bool cut = ett.has_edge(a, b);
+    bool link = !cut && ett.get_root(a) != ett.get_root(b) && rand() % 2;
+    for (EulerTourTree* tree : {&ett, &own1, &own2}) {
+      if (cut) tree->cut(a, b);
+      if (link) tree->link(a, b);
+    }
+    vec_t update_idx = rand();
+    ett.update_sketches(a, b, update_idx);
+    own1.update_sketches(a, b, update_idx);
+    own2.update_sketches(a, b, update_idx);
+    check_root(a);
+    check_root(b);
+  }
+  ett.remove_shared_tiers(1);
+  ASSERT_EQ(ett.num_shared_tiers(), 1);
+  for (int v = 0; v < nodecount; v++)
+    check_root(v);
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include "graph_host.h"
+#include "mat_graph_verifier.h"
+
+TEST(GraphHostSuite, multi_graph_correctness_test) {
+    // The host graphs must not depend on the process wide defaults
+    vec_t default_sketch_len = sketch_len;
+    double default_height_factor = height_factor;
+    sketch_len = 0;
+    height_factor = 0;
+
+    std::vector<node_id_t> sizes = {10, 50, 200, 37, 64};
+    int seed = time(NULL);
+    srand(seed);
+    std::cout << "Seeding multi graph correctness test with " << seed << std::endl;
+    for (uint32_t num_threads : {1, 4}) {
+        GraphHost host(sizes.size(), 20, num_threads);
+        std::vector<MatGraphVerifier> verifiers;
+        std::vector<std::vector<std::vector<bool>>> adj;
+        for (node_id_t num_nodes : sizes) {
+            GraphConfig config;
+            config.height_factor = 1/log2(log2(num_nodes));
+            config.sketch_len = Sketch::calc_vector_length(num_nodes);
+            config.sketch_err = 1;
+            config.skiplist_seed = rand();
+            config.sketchless_height_factor = config.height_factor;
+            config.sketchless_skiplist_seed = rand();
+            host.add_graph(num_nodes, config, num_nodes % 2);
+            verifiers.emplace_back(num_nodes);
+            adj.emplace_back(num_nodes, std::vector<bool>(num_nodes, false));
+        }
+        for (int i = 0; i < 20000; i++) {
+            uint32_t g = rand() % sizes.size();
+            node_id_t a = rand() % sizes[g], b = rand() % sizes[g];
+            if (a == b) continue;
+            if (a > b) std::swap(a, b);
+            host.update(g, {{a, b}, adj[g][a][b] ? DELETE : INSERT});
+            adj[g][a][b] = !adj[g][a][b];
+            verifiers[g].edge_update(a, b);
+            if (i % 1000 == 999) {
+                for (uint32_t h = 0; h < sizes.size(); h++) {
+                    std::vector<std::set<node_id_t>> cc = host.get_cc(h);
+                    try {
+                        verifiers[h].reset_cc_state();
+                        verifiers[h].verify_soln(cc);
+                    } catch (IncorrectCCException& e) {
+                        std::cout << "Incorrect cc found for graph " << h << " at update " << i << std::endl;
+                        FAIL();
+                    }
+                }
+            }
+        }
+    }
+    sketch_len = default_sketch_len;
+    height_factor = default_height_factor;
+}
@@ -15,21 +15,27 @@ auto start = std::chrono::high_resolution_clock::now();
 auto stop = std::chrono::high_resolution_clock::now();
 auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
 
-static void print_metrics() {
+static void print_metrics(const GraphTiers& gt) {
+    const GraphTiersMetrics& metrics = gt.get_metrics();
     stop = std::chrono::high_resolution_clock::now();
     duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
     std::cout << "\nTotal time for all updates performed (ms): " << duration.count() << std::endl;
-    std::cout << "\tTotal time in Sketch update (ms): " << sketch_time/1000 << std::endl;
-    std::cout << "\tTotal time in Refresh function (ms): " << refresh_time/1000 << std::endl;
-    std::cout << "\t\tTime in Parallel isolated checking (ms): " << parallel_isolated_check/1000 << std::endl;
-    std::cout << "\t\tTime in Sketch queries (ms): " << sketch_query/1000 << std::endl;
-    std::cout << "\t\tTime in LCT operations (ms): " << lct_time/1000 << std::endl;
-    std::cout << "\t\tTime in ETT operations (ms): " << (ett_time+ett_find_root+ett_get_agg)/1000 << std::endl;
-    std::cout << "\t\t\tETT Split and Join (ms): " << ett_time/1000 << std::endl;
-    std::cout << "\t\t\tETT Find Tree Root (ms): " << ett_find_root/1000 << std::endl;
-    std::cout << "\t\t\tETT Get Aggregate (ms): " << ett_get_agg/1000 << std::endl;
-    std::cout << "Total number of tiers grown: " << tiers_grown << std::endl;
-    std::cout << "Total number of normal refreshes: " << normal_refreshes << std::endl;
+    std::cout << "\tTotal time in Sketch update (ms): " << metrics.sketch_time/1000 << std::endl;
+    std::cout << "\tTotal time in Refresh function (ms): " << metrics.refresh_time/1000 << std::endl;
+    std::cout << "\t\tTime in Parallel isolated checking (ms): " << metrics.parallel_isolated_check/1000 << std::endl;
+    std::cout << "\t\tTime in Sketch queries (ms): " << metrics.sketch_query/1000 << std::endl;
+    std::cout << "\t\tTime in LCT operations (ms): " << metrics.lct_time/1000 << std::endl;
+    std::cout << "\t\tTime in ETT operations (ms): " << (metrics.ett_time+metrics.ett_find_root+metrics.ett_get_agg)/1000 << std::endl;
+    std::cout << "\t\t\tETT Split and Join (ms): " << metrics.ett_time/1000 << std::endl;
+    std::cout << "\t\t\tETT Find Tree Root (ms): " << metrics.ett_find_root/1000 << std::endl;
+    std::cout << "\t\t\tETT Get Aggregate (ms): " << metrics.ett_get_agg/1000 << std::endl;
+    std::cout << "Total number of tiers grown: " << metrics.tiers_grown << std::endl;
+    std::cout << "Total number of normal refreshes: " << metrics.normal_refreshes << std::endl;
+    std::cout << "Total number of updates passing the isolated check without refresh: " << metrics.updates_without_refresh << std::endl;
+    std::cout << "Total number of endpoint checks skipped after isolation found: " << metrics.isolated_check_skipped << std::endl;
+    std::cout << "Total number of tier sketch samples skipped for unchanged roots: " << metrics.sketch_samples_skipped << std::endl;
+    std::cout << "Total number of tiers collapsed: " << metrics.tiers_collapsed << std::endl;
+    std::cout << "Total number of tiers materialized: " << metrics.tiers_materialized << std::endl;
 }
 
 TEST(GraphTiersSuite, mini_correctness_test) {
@@ -67,6 +73,88 @@ TEST(GraphTiersSuite, mini_correctness_test) {
     }
 }
 
+TEST(GraphTiersSuite, mini_batch_correctness_test) {
+    node_id_t numnodes = 10;
+    GraphTiers gt(numnodes);
+    MatGraphVerifier gv(numnodes);
+
+    // Link all of the nodes into 1 connected component in one batch
+    std::vector<GraphUpdate> updates;
+    for (node_id_t i = 0; i < numnodes-1; i++) {
+        updates.push_back({{i, i+1}, INSERT});
+        gv.edge_update(i,i+1);
+    }
+    gt.update_batch(updates);
+    std::vector<std::set<node_id_t>> cc = gt.get_cc();
+    try {
+        gv.reset_cc_state();
+        gv.verify_soln(cc);
+    } catch (IncorrectCCException& e) {
+        std::cout << "Incorrect cc found after linking batch" << std::endl;
+        std::cout << "GOT: " << cc.size() << " components, EXPECTED: 1 components" << std::endl;
+        FAIL();
+    }
+    // Add a cycle edge then cut every path edge in one batch
+    updates.clear();
+    updates.push_back({{0, numnodes-1}, INSERT});
+    gv.edge_update(0, numnodes-1);
+    for (node_id_t i = 0; i < numnodes-1; i++) {
+        updates.push_back({{i, i+1}, DELETE});
+        gv.edge_update(i,i+1);
+    }
+    gt.update_batch(updates);
+    cc = gt.get_cc();
+    try {
+        gv.reset_cc_state();
+        gv.verify_soln(cc);
+    } catch (IncorrectCCException& e) {
+        std::cout << "Incorrect cc found after cutting batch" << std::endl;
+        std::cout << "GOT: " << cc.size() << " components, EXPECTED: " << numnodes-1 << " components" << std::endl;
+        FAIL();
+    }
+}
+
+TEST(GraphTiersSuite, mini_collapsed_correctness_test) {
+    node_id_t numnodes = 50;
+    GraphTiers gt(numnodes, 0, true);
+    MatGraphVerifier gv(numnodes);
+    std::vector<std::vector<bool>> adj(numnodes, std::vector<bool>(numnodes, false));
+    int seed = time(NULL);
+    srand(seed);
+    std::cout << "Seeding mini collapsed correctness test with " << seed << std::endl;
+
+    // Random inserts and deletes so tiers keep collapsing and materializing
+    std::vector<GraphUpdate> updates;
+    for (int i = 0; i < 5000; i++) {
+        node_id_t a = rand() % numnodes, b = rand() % numnodes;
+        if (a == b) continue;
+        if (a > b) std::swap(a, b);
+        GraphUpdate update = {{a, b}, adj[a][b] ? DELETE : INSERT};
+        adj[a][b] = !adj[a][b];
+        gv.edge_update(a, b);
+        if ((i/100)%2 == 0) {
+            gt.update(update);
+        } else {
+            updates.push_back(update);
+            if (updates.size() == 25) {
+                gt.update_batch(updates);
+                updates.clear();
+            }
+        }
+        if (updates.empty() && i%50 == 0) {
+            std::vector<std::set<node_id_t>> cc = gt.get_cc();
+            try {
+                gv.reset_cc_state();
+                gv.verify_soln(cc);
+            } catch (IncorrectCCException& e) {
+                std::cout << "Incorrect cc found at update " << i << std::endl;
+                std::cout << "GOT: " << cc.size() << " components" << std::endl;
+                FAIL();
+            }
+        }
+    }
+}
+
 TEST(GraphTiersSuite, deletion_replace_correctness_test) {
     node_id_t numnodes = 50;
     GraphTiers gt(numnodes);
@@ -156,6 +244,108 @@ TEST(GraphTiersSuite, omp_correctness_test) {
     }
 }
 
+TEST(GraphTiersSuite, omp_batch_correctness_test) {
+    omp_set_dynamic(1);
+    try {
+        BinaryGraphStream stream(stream_file, 100000);
+
+        height_factor = 1/log2(log2(stream.nodes()));
+        sketch_len = Sketch::calc_vector_length(stream.nodes());
+        sketch_err = DEFAULT_SKETCH_ERR;
+
+        GraphTiers gt(stream.nodes());
+        int edgecount = stream.edges();
+        edgecount = 1000000;
+        int batch_size = 100;
+        MatGraphVerifier gv(stream.nodes());
+        std::vector<GraphUpdate> updates;
+        start = std::chrono::high_resolution_clock::now();
+
+        for (int i = 0; i < edgecount; i++) {
+            GraphUpdate update = stream.get_edge();
+            updates.push_back(update);
+            gv.edge_update(update.edge.src, update.edge.dst);
+            unlikely_if(updates.size() == (size_t)batch_size || i == edgecount-1) {
+                gt.update_batch(updates);
+                updates.clear();
+            }
+            unlikely_if(updates.empty() && (i%1000 == 999 || i == edgecount-1)) {
+                std::vector<std::set<node_id_t>> cc = gt.get_cc();
+                try {
+                    gv.reset_cc_state();
+                    gv.verify_soln(cc);
+                    std::cout << "Update " << i << ", CCs correct." << std::endl;
+                } catch (IncorrectCCException& e) {
+                    std::cout << "Incorrect connected components found at update "  << i << std::endl;
+		            std::cout << "GOT: " << cc.size() << std::endl;
+                    FAIL();
+                }
+            }
+        }
+        std::ofstream file;
+        file.open ("omp_kron_results.txt", std::ios_base::app);
+        file << stream_file << " passed batch correctness test." << std::endl;
+        file.close();
+
+    } catch (BadStreamException& e) {
+        std::cout << "ERROR: Stream binary file not found." << std::endl;
+    }
+}
+
+TEST(GraphTiersSuite, omp_collapsed_correctness_test) {
+    omp_set_dynamic(1);
+    try {
+        BinaryGraphStream stream(stream_file, 100000);
+
+        height_factor = 1/log2(log2(stream.nodes()));
+        sketch_len = Sketch::calc_vector_length(stream.nodes());
+        sketch_err = DEFAULT_SKETCH_ERR;
+
+        GraphTiers gt(stream.nodes(), 0, true);
+        int edgecount = stream.edges();
+        edgecount = 1000000;
+        int batch_size = 100;
+        MatGraphVerifier gv(stream.nodes());
+        std::vector<GraphUpdate> updates;
+        start = std::chrono::high_resolution_clock::now();
+
+        // Alternate between single and batched updates so both paths see collapsed tiers
+        for (int i = 0; i < edgecount; i++) {
+            GraphUpdate update = stream.get_edge();
+            gv.edge_update(update.edge.src, update.edge.dst);
+            if ((i/batch_size)%2 == 0) {
+                gt.update(update);
+            } else {
+                updates.push_back(update);
+                unlikely_if(updates.size() == (size_t)batch_size || i == edgecount-1) {
+                    gt.update_batch(updates);
+                    updates.clear();
+                }
+            }
+            unlikely_if(updates.empty() && (i%1000 == 999 || i == edgecount-1)) {
+                std::vector<std::set<node_id_t>> cc = gt.get_cc();
+                try {
+                    gv.reset_cc_state();
+                    gv.verify_soln(cc);
+                    std::cout << "Update " << i << ", CCs correct." << std::endl;
+                } catch (IncorrectCCException& e) {
+                    std::cout << "Incorrect connected components found at update "  << i << std::endl;
+		            std::cout << "GOT: " << cc.size() << std::endl;
+                    FAIL();
+                }
+            }
+        }
+        print_metrics(gt);
+        std::ofstream file;
+        file.open ("omp_kron_results.txt", std::ios_base::app);
+        file << stream_file << " passed collapsed correctness test." << std::endl;
+        file.close();
+
+    } catch (BadStreamException& e) {
+        std::cout << "ERROR: Stream binary file not found." << std::endl;
+    }
+}
+
 TEST(GraphTiersSuite, omp_speed_test) {
     omp_set_dynamic(1);
     try {
@@ -181,7 +371,7 @@ TEST(GraphTiersSuite, omp_speed_test) {
             }
         }
 	    STOP(time, timer);
-        print_metrics();
+        print_metrics(gt);
         std::ofstream file;
         file.open ("omp_kron_results.txt", std::ios_base::app);
         file << stream_file << " time (ms): "<< time/1000 << std::endl;
@@ -192,6 +382,42 @@ TEST(GraphTiersSuite, omp_speed_test) {
     }
 }
 
+TEST(GraphTiersSuite, omp_batch_speed_test) {
+    omp_set_dynamic(1);
+    try {
+        BinaryGraphStream stream(stream_file, 100000);
+
+        height_factor = 1./log2(log2(stream.nodes()));
+        sketch_len = Sketch::calc_vector_length(stream.nodes());
+        sketch_err = DEFAULT_SKETCH_ERR;
+
+        GraphTiers gt(stream.nodes());
+        int edgecount = stream.edges();
+        int batch_size = 100;
+        std::vector<GraphUpdate> updates;
+        start = std::chrono::high_resolution_clock::now();
+
+        for (int i = 0; i < edgecount; i++) {
+            updates.push_back(stream.get_edge());
+            unlikely_if(updates.size() == (size_t)batch_size || i == edgecount-1) {
+                gt.update_batch(updates);
+                updates.clear();
+            }
+            unlikely_if (i % 100000 == 0) {
+                std::cout << "FINISHED UPDATE " << i << " OUT OF " << edgecount << " IN " << stream_file << std::endl;
+            }
+        }
+        print_metrics(gt);
+        std::ofstream file;
+        file.open ("omp_kron_results.txt", std::ios_base::app);
+        file << stream_file << " batch time (ms): "<< duration.count() << std::endl;
+        file.close();
+
+    } catch (BadStreamException& e) {
+        std::cout << "ERROR: Stream binary file not found." << std::endl;
+    }
+}
+
 TEST(GraphTiersSuite, query_speed_test) {
     omp_set_dynamic(1);
     try {
@@ -169,7 +169,7 @@ TEST(LinkCutTreeSuite, random_links_and_cuts) {
                 //std::cout << i << ": Linking " << a << " and " << b << " weight " << weight << std::endl;
                 lct.link(a, b, weight);
                 //print_paths(&lct.nodes);
-            } else if (lct.nodes[a].edges.find(&lct.nodes[b]-&lct.nodes[0]) != lct.nodes[a].edges.end()) {
+            } else if (lct.has_edge(a, b)) {
                 //std::cout << i << ": Cutting " << a << " and " << b << std::endl;
                 lct.cut(a, b);
                 //print_paths(&lct.nodes);
@@ -181,8 +181,8 @@ TEST(LinkCutTreeSuite, random_links_and_cuts) {
     // Manually compute the aggregates for each aux tree
     std::map<LinkCutNode*, uint32_t> path_aggregates;
     for (int i = 0; i < nodecount; i++) {
-        uint32_t nodemax = std::max(lct.nodes[i].edges[lct.nodes[i].preferred_edges.first],
-                lct.nodes[i].edges[lct.nodes[i].preferred_edges.second]);
+        uint32_t nodemax = std::max(lct.nodes[i].preferred_weights.first,
+                lct.nodes[i].preferred_weights.second);
         LinkCutNode* curr = &lct.nodes[i];
         while (curr) {
             if (curr->get_parent() == nullptr) {
@@ -200,3 +200,44 @@ TEST(LinkCutTreeSuite, random_links_and_cuts) {
         EXPECT_EQ(agg.second, agg.first->max) << "Aggregate incorrect" << std::endl;
     }
 }
+
+TEST(LinkCutTreeSuite, connected_path_max_test) {
+    int nodecount = 1000;
+    LinkCutTree lct(nodecount);
+    int seed = time(NULL);
+    std::cout << "Seeding connected path max test with " << seed << std::endl;
+    srand(seed);
+    // Build a random forest
+    for (int i = 0; i < 3*nodecount; i++) {
+        node_id_t a = rand() % nodecount, b = rand() % nodecount;
+        if (a != b && lct.find_root(a) != lct.find_root(b))
+            lct.link(a, b, 1 + rand()%100);
+    }
+    // Compare the fused query with the separate find_root and path_aggregate queries
+    std::vector<std::pair<node_id_t, node_id_t>> queries;
+    std::vector<PathMaxResult> expected;
+    for (int i = 0; i < 1000; i++) {
+        node_id_t a = rand() % nodecount, b = rand() % nodecount;
+        PathMaxResult result;
+        result.connected = lct.find_root(a) == lct.find_root(b);
+        if (result.connected) {
+            std::pair<edge_id_t, uint32_t> max = lct.path_aggregate(a, b);
+            result.max_edge = max.first;
+            result.weight = max.second;
+        }
+        PathMaxResult fused = lct.connected_path_max(a, b);
+        ASSERT_EQ(fused.connected, result.connected);
+        ASSERT_EQ(fused.weight, result.weight);
+        queries.push_back({a, b});
+        expected.push_back(result);
+    }
+    // The batched version answers in the order of the queries
+    std::vector<PathMaxResult> batched = lct.connected_path_max(queries);
+    ASSERT_EQ(batched.size(), queries.size());
+    for (uint32_t i = 0; i < queries.size(); i++) {
+        ASSERT_EQ(batched[i].connected, expected[i].connected);
+        ASSERT_EQ(batched[i].weight, expected[i].weight);
+    }
+    ASSERT_TRUE(std::all_of(lct.nodes.begin(), lct.nodes.end(), [](auto& node){return validate(&node);}))
+      << "One or more invalid nodes found" << std::endl;
+}
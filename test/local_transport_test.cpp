@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <numeric>
+
+#include "../include/local_transport.h"
+
+
+TEST(LocalTransportSuite, bcast_ring_wraparound_test) {
+    // Many more broadcasts than ring slots, with the nonblocking ones overlapping
+    std::atomic<int> errors{0};
+    run_local(4, [&](Transport& world) {
+        std::vector<TransportRequest> requests;
+        std::vector<uint32_t> values(2000);
+        for (uint32_t i = 0; i < values.size(); i++) {
+            if (world.rank() == (int)(i%4))
+                values[i] = i*7+1;
+            if (i%3 == 0)
+                world.bcast(&values[i], sizeof(uint32_t), i%4);
+            else
+                requests.push_back(world.ibcast(&values[i], sizeof(uint32_t), i%4));
+            if (requests.size() == 100)
+                world.waitall(requests), requests.clear();
+        }
+        world.waitall(requests);
+        for (uint32_t i = 0; i < values.size(); i++)
+            if (values[i] != i*7+1)
+                errors++;
+    });
+    ASSERT_EQ(errors, 0);
+}
+
+TEST(LocalTransportSuite, point_to_point_order_test) {
+    std::atomic<int> errors{0};
+    run_local(3, [&](Transport& world) {
+        if (world.rank() != 0) {
+            for (int i = 0; i < 500; i++) {
+                int message = world.rank()*1000+i;
+                TransportRequest request = world.isend(&message, sizeof(int), 0, i%2);
+                world.wait(request);
+            }
+            return;
+        }
+        // Receives posted for one source and tag complete in the order the messages were sent
+        std::vector<int> received(1000);
+        std::vector<TransportRequest> requests;
+        for (int i = 0; i < 500; i++)
+            requests.push_back(world.irecv(&received[i], sizeof(int), 1, i%2));
+        for (int i = 0; i < 500; i++) {
+            ASSERT_EQ(world.probe(2, i%2), (int)sizeof(int));
+            world.recv(&received[500+i], sizeof(int), 2, i%2);
+        }
+        world.waitall(requests);
+        for (int i = 0; i < 500; i++)
+            if (received[i] != 1000+i || received[500+i] != 2000+i)
+                errors++;
+    });
+    ASSERT_EQ(errors, 0);
+}
+
+TEST(LocalTransportSuite, reduction_test) {
+    std::atomic<int> errors{0};
+    run_local(5, [&](Transport& world) {
+        for (uint32_t round = 0; round < 100; round++) {
+            if (world.allreduce_min(world.rank()*3+round) != round)
+                errors++;
+            std::vector<uint32_t> bits(4, 0), result(4, 0);
+            bits[round%4] = 1 << world.rank();
+            world.reduce_bitwise_or(bits.data(), result.data(), bits.size(), round%5);
+            if (world.rank() == (int)(round%5) && result[round%4] != 31)
+                errors++;
+        }
+    });
+    ASSERT_EQ(errors, 0);
+}
+
+TEST(LocalTransportSuite, split_dup_test) {
+    std::atomic<int> errors{0};
+    run_local(6, [&](Transport& world) {
+        bool member = world.rank() != 2;
+        std::unique_ptr<Transport> comm = world.split(member);
+        if (!member) {
+            if (comm)
+                errors++;
+            world.barrier();
+            return;
+        }
+        if (comm->size() != 5 || comm->rank() != world.rank() - (world.rank() > 2))
+            errors++;
+        std::unique_ptr<Transport> other = comm->dup();
+        // Traffic of the duplicate does not mix with the original one
+        int a = comm->rank(), b = -comm->rank();
+        TransportRequest request = other->ibcast(&b, sizeof(int), 1);
+        comm->bcast(&a, sizeof(int), 0);
+        other->wait(request);
+        if (a != 0 || b != -1)
+            errors++;
+        world.barrier();
+    });
+    ASSERT_EQ(errors, 0);
+}
+
+TEST(LocalTransportSuite, neighbor_chain_test) {
+    std::atomic<int> errors{0};
+    run_local(5, [&](Transport& world) {
+        // Every rank sends to the rank below it and receives from the rank above it
+        int rank = world.rank();
+        std::vector<int> sources, destinations;
+        if (rank != 4)
+            sources.push_back(rank+1);
+        if (rank != 0)
+            destinations.push_back(rank-1);
+        std::unique_ptr<Transport> chain = world.neighbors(sources, destinations);
+        std::vector<uint32_t> sent(100), received(100, 0);
+        std::vector<TransportRequest> requests;
+        for (uint32_t i = 0; i < sent.size(); i += 10) {
+            for (uint32_t j = i; j < i+10; j++)
+                sent[j] = rank*1000+j;
+            requests.push_back(chain->ineighbor_alltoall(&sent[i], &received[i], 10*sizeof(uint32_t)));
+        }
+        chain->waitall(requests);
+        for (uint32_t j = 0; j < received.size(); j++)
+            if (received[j] != (rank == 4 ? 0 : (rank+1)*1000+j))
+                errors++;
+    });
+    ASSERT_EQ(errors, 0);
+}
@@ -5,14 +5,17 @@
 #include <random>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <omp.h>
 #include "mpi_nodes.h"
+#include "local_transport.h"
 #include "binary_graph_stream.h"
 #include "mat_graph_verifier.h"
 #include "util.h"
 
 
 const int DEFAULT_BATCH_SIZE = 100;
+const int MAX_ADAPTIVE_BATCH_SIZE = 1000;
 const vec_t DEFAULT_SKETCH_ERR = 1;
 
 TEST(GraphTierSuite, mpi_update_speed_test) {
@@ -41,15 +44,15 @@ TEST(GraphTierSuite, mpi_update_speed_test) {
     std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
     int seed = dist(rng);
-    bcast(&seed, sizeof(int), 0);
+    mpi_world().bcast(&seed, sizeof(int), 0);
     std::cout << "SEED: " << seed << std::endl;
     rng.seed(seed);
     for (int i = 0; i < world_rank; i++)
         dist(rng);
     int tier_seed = dist(rng);
 
-    if (world_size != num_tiers+1)
-        FAIL() << "MPI world size too small for graph with " << num_nodes << " vertices. Correct world size is: " << num_tiers+1;
+    if (world_size < 2 || world_size > num_tiers+1)
+        FAIL() << "MPI world size for graph with " << num_nodes << " vertices must be between 2 and " << num_tiers+1;
 
     if (world_rank == 0) {
         int seed = time(NULL);
@@ -78,9 +81,8 @@ TEST(GraphTierSuite, mpi_update_speed_test) {
         file << stream_file << " UPDATES/SECOND: " << edgecount/(time/1000)*1000 << std::endl;
         file.close();
 
-    } else if (world_rank < num_tiers+1) {
-        int tier_num = world_rank-1;
-        TierNode tier_node(num_nodes, tier_num, num_tiers, update_batch_size, tier_seed);
+    } else {
+        TierNode tier_node(num_nodes, num_tiers, update_batch_size, tier_seed);
         tier_node.main();
     }
 }
@@ -112,15 +114,15 @@ TEST(GraphTiersSuite, mpi_query_speed_test) {
     std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
     int seed = dist(rng);
-    bcast(&seed, sizeof(int), 0);
+    mpi_world().bcast(&seed, sizeof(int), 0);
     std::cout << "SEED: " << seed << std::endl;
     rng.seed(seed);
     for (int i = 0; i < world_rank; i++)
         dist(rng);
     int tier_seed = dist(rng);
 
-    if (world_size != num_tiers+1)
-        FAIL() << "MPI world size too small for graph with " << num_nodes << " vertices. Correct world size is: " << num_tiers+1;
+    if (world_size < 2 || world_size > num_tiers+1)
+        FAIL() << "MPI world size for graph with " << num_nodes << " vertices must be between 2 and " << num_tiers+1;
 
     if (world_rank == 0) {
         int seed = time(NULL);
@@ -156,9 +158,8 @@ TEST(GraphTiersSuite, mpi_query_speed_test) {
         file << stream_file << " QUERIES/SECOND: " << 1000000000/(total_time/1000)*1000 << std::endl;
         file.close();
 
-    } else if (world_rank < num_tiers+1) {
-        int tier_num = world_rank-1;
-        TierNode tier_node(num_nodes, world_rank-1, num_tiers, update_batch_size, tier_seed);
+    } else {
+        TierNode tier_node(num_nodes, num_tiers, update_batch_size, tier_seed);
         tier_node.main();
     }
 }
@@ -173,8 +174,8 @@ TEST(GraphTiersSuite, mpi_mini_correctness_test) {
 
     uint32_t num_nodes = 100;
     uint32_t num_tiers = log2(num_nodes)/(log2(3)-1);
-    if (world_size != num_tiers+1)
-        FAIL() << "MPI world size too small for graph with " << num_nodes << " vertices. Correct world size is: " << num_tiers+1;
+    if (world_size < 2 || world_size > num_tiers+1)
+        FAIL() << "MPI world size for graph with " << num_nodes << " vertices must be between 2 and " << num_tiers+1;
     // Parameters
     int update_batch_size = 1;
     height_factor = 1;
@@ -186,7 +187,7 @@ TEST(GraphTiersSuite, mpi_mini_correctness_test) {
     std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
     int seed = dist(rng);
-    bcast(&seed, sizeof(int), 0);
+    mpi_world().bcast(&seed, sizeof(int), 0);
     std::cout << "SEED: " << seed << std::endl;
     rng.seed(seed);
     for (int i = 0; i < world_rank; i++)
@@ -229,9 +230,8 @@ TEST(GraphTiersSuite, mpi_mini_correctness_test) {
         }
         // Communicate to all other nodes that the stream has ended
         input_node.end();
-    } else if (world_rank < num_tiers+1) {
-        int tier_num = world_rank-1;
-        TierNode tier_node(num_nodes, tier_num, num_tiers, update_batch_size, tier_seed);
+    } else {
+        TierNode tier_node(num_nodes, num_tiers, update_batch_size, tier_seed);
         tier_node.main();
     }
 }
@@ -246,8 +246,8 @@ TEST(GraphTiersSuite, mpi_mini_replacement_test) {
 
     uint32_t num_nodes = 100;
     uint32_t num_tiers = log2(num_nodes)/(log2(3)-1);
-    if (world_size != num_tiers+1)
-        FAIL() << "MPI world size too small for graph with " << num_nodes << " vertices. Correct world size is: " << num_tiers+1;
+    if (world_size < 2 || world_size > num_tiers+1)
+        FAIL() << "MPI world size for graph with " << num_nodes << " vertices must be between 2 and " << num_tiers+1;
     // Parameters
     int update_batch_size = 1;
     height_factor = 1;
@@ -259,7 +259,7 @@ TEST(GraphTiersSuite, mpi_mini_replacement_test) {
     std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
     int seed = dist(rng);
-    bcast(&seed, sizeof(int), 0);
+    mpi_world().bcast(&seed, sizeof(int), 0);
     std::cout << "SEED: " << seed << std::endl;
     rng.seed(seed);
     for (int i = 0; i < world_rank; i++)
@@ -310,9 +310,8 @@ TEST(GraphTiersSuite, mpi_mini_replacement_test) {
         }
         // Communicate to all other nodes that the stream has ended
         input_node.end();
-    } else if (world_rank < num_tiers+1) {
-        int tier_num = world_rank-1;
-        TierNode tier_node(num_nodes, tier_num, num_tiers, update_batch_size, tier_seed);
+    } else {
+        TierNode tier_node(num_nodes, num_tiers, update_batch_size, tier_seed);
         tier_node.main();
     }
 }
@@ -327,8 +326,8 @@ TEST(GraphTiersSuite, mpi_mini_batch_test) {
 
     uint32_t num_nodes = 100;
     uint32_t num_tiers = log2(num_nodes)/(log2(3)-1);
-    if (world_size != num_tiers+1)
-        FAIL() << "MPI world size too small for graph with " << num_nodes << " vertices. Correct world size is: " << num_tiers+1;
+    if (world_size < 2 || world_size > num_tiers+1)
+        FAIL() << "MPI world size for graph with " << num_nodes << " vertices must be between 2 and " << num_tiers+1;
     // Parameters
     int update_batch_size = 10;
     height_factor = 1;
@@ -340,7 +339,7 @@ TEST(GraphTiersSuite, mpi_mini_batch_test) {
     std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
     int seed = dist(rng);
-    bcast(&seed, sizeof(int), 0);
+    mpi_world().bcast(&seed, sizeof(int), 0);
     std::cout << "SEED: " << seed << std::endl;
     rng.seed(seed);
     for (int i = 0; i < world_rank; i++)
@@ -441,14 +440,28 @@ TEST(GraphTiersSuite, mpi_mini_batch_test) {
         }
         // Communicate to all other nodes that the stream has ended
         input_node.end();
-    } else if (world_rank < num_tiers+1) {
-        int tier_num = world_rank-1;
-        TierNode tier_node(num_nodes, tier_num, num_tiers, update_batch_size, tier_seed);
+    } else {
+        TierNode tier_node(num_nodes, num_tiers, update_batch_size, tier_seed);
         tier_node.main();
     }
 }
 
-TEST(GraphTiersSuite, mpi_correctness_test) {
+// Called on the input node after each verified cc query with the components it returned
+typedef std::function<void(InputNode& input_node, const std::vector<std::set<node_id_t>>& cc)> CorrectnessHook;
+
+// Names the features of a correctness run in mpi_kron_results.txt
+static std::string options_name(const InputNodeOptions& options) {
+    std::string name;
+    if (options.concurrent_refresh) name += "concurrent refresh ";
+    if (options.reorder_batches) name += "reordered batch ";
+    if (options.max_batch_size > 0) name += "adaptive batch ";
+    if (options.replicated_lct) name += "replicated LCT ";
+    if (options.query_node) name += "query node ";
+    return name;
+}
+
+// Stream the graph through an InputNode with the given options and check the connected components every 1000 updates
+static void run_mpi_correctness(InputNodeOptions options, CorrectnessHook check_hook = nullptr) {
     int world_rank_buf;
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank_buf);
     uint32_t world_rank = world_rank_buf;
@@ -461,6 +474,8 @@ TEST(GraphTiersSuite, mpi_correctness_test) {
     uint32_t num_tiers = log2(num_nodes)/(log2(3)-1);
     // Parameters
     int update_batch_size = DEFAULT_BATCH_SIZE;
+    // Adaptive batches need tier nodes built for the largest batch
+    int tier_batch_size = std::max(update_batch_size, options.max_batch_size);
     height_factor = 1./log2(log2(num_nodes));
     sketch_len = Sketch::calc_vector_length(num_nodes);
 	sketch_err = DEFAULT_SKETCH_ERR;
@@ -470,21 +485,24 @@ TEST(GraphTiersSuite, mpi_correctness_test) {
     std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
     int seed = dist(rng);
-    bcast(&seed, sizeof(int), 0);
+    mpi_world().bcast(&seed, sizeof(int), 0);
     std::cout << "SEED: " << seed << std::endl;
     rng.seed(seed);
     for (int i = 0; i < world_rank; i++)
         dist(rng);
     int tier_seed = dist(rng);
 
-    if (world_size != num_tiers+1)
-        FAIL() << "MPI world size too small for graph with " << num_nodes << " vertices. Correct world size is: " << num_tiers+1;
+    // A query node takes the last rank
+    uint32_t min_size = options.query_node ? 3 : 2;
+    uint32_t max_size = options.query_node ? num_tiers+2 : num_tiers+1;
+    if (world_size < min_size || world_size > max_size)
+        FAIL() << "MPI world size for graph with " << num_nodes << " vertices must be between " << min_size << " and " << max_size;
 
     if (world_rank == 0) {
         int seed = time(NULL);
         srand(seed);
         std::cout << "InputNode seed: " << seed << std::endl;
-        InputNode input_node(num_nodes, num_tiers, update_batch_size, seed);
+        InputNode input_node(num_nodes, num_tiers, update_batch_size, seed, default_graph_config(), options);
         MatGraphVerifier gv(num_nodes);
         int edgecount = stream.edges();
 	    int count = 20000000;
@@ -500,25 +518,157 @@ TEST(GraphTiersSuite, mpi_correctness_test) {
                 try {
                     gv.reset_cc_state();
                     gv.verify_soln(cc);
-                    std::cout << "Update " << i << ", CCs correct." << std::endl;
+                    std::cout << "Update " << i << ", CCs correct. Batch size " << input_node.get_batch_size() << std::endl;
                 } catch (IncorrectCCException& e) {
                     std::cout << "Incorrect connected components found at update "  << i << std::endl;
                     std::cout << "GOT: " << cc.size() << std::endl;
                     input_node.end();
                     FAIL();
                 }
+                if (check_hook) {
+                    check_hook(input_node, cc);
+                    if (::testing::Test::HasFailure()) {
+                        input_node.end();
+                        return;
+                    }
+                }
             }
         }
         std::ofstream file;
         file.open ("mpi_kron_results.txt", std::ios_base::app);
-        file << stream_file << " passed correctness test." << std::endl;
+        file << stream_file << " passed " << options_name(options) << "correctness test." << std::endl;
         file.close();
         // Communicate to all other nodes that the stream has ended
         input_node.end();
 
-    } else if (world_rank < num_tiers+1) {
-        int tier_num = world_rank-1;
-        TierNode tier_node(num_nodes, tier_num, num_tiers, update_batch_size, tier_seed);
+    } else if (options.query_node && world_rank == world_size-1) {
+        QueryNode query_node(num_nodes, tier_seed);
+        query_node.main();
+    } else {
+        TierNode tier_node(num_nodes, num_tiers, tier_batch_size, tier_seed);
         tier_node.main();
     }
 }
+
+TEST(GraphTiersSuite, mpi_correctness_test) {
+    run_mpi_correctness(InputNodeOptions());
+}
+
+TEST(GraphTiersSuite, mpi_replicated_lct_correctness_test) {
+    InputNodeOptions options;
+    options.replicated_lct = true;
+    run_mpi_correctness(options);
+}
+
+TEST(GraphTiersSuite, mpi_query_node_correctness_test) {
+    InputNodeOptions options;
+    options.query_node = true;
+    // Queries submitted at the last check, answered while the stream went on
+    uint32_t cc_query = 0, connectivity_query = 0;
+    std::set<std::set<node_id_t>> submitted_cc;
+    bool submitted_connected = false;
+    bool submitted = false;
+    run_mpi_correctness(options, [&](InputNode& input_node, const std::vector<std::set<node_id_t>>& cc) {
+        if (submitted) {
+            std::vector<std::set<node_id_t>> answer = input_node.cc_answer(cc_query);
+            ASSERT_EQ(std::set<std::set<node_id_t>>(answer.begin(), answer.end()), submitted_cc);
+            ASSERT_EQ(input_node.connectivity_answer(connectivity_query), submitted_connected);
+        }
+        // The answers must match the graph up to this update even though later ones are processed first
+        node_id_t num_nodes = 0;
+        for (auto& component : cc)
+            num_nodes += component.size();
+        node_id_t a = rand()%num_nodes, b = rand()%num_nodes;
+        cc_query = input_node.submit_cc_query();
+        connectivity_query = input_node.submit_connectivity_query(a, b);
+        submitted_cc = std::set<std::set<node_id_t>>(cc.begin(), cc.end());
+        submitted_connected = false;
+        for (auto& component : cc)
+            if (component.count(a))
+                submitted_connected = component.count(b);
+        submitted = true;
+    });
+}
+
+TEST(GraphTiersSuite, mpi_concurrent_refresh_correctness_test) {
+    InputNodeOptions options;
+    options.concurrent_refresh = true;
+    run_mpi_correctness(options);
+}
+
+TEST(GraphTiersSuite, mpi_reordered_correctness_test) {
+    InputNodeOptions options;
+    options.reorder_batches = true;
+    run_mpi_correctness(options);
+}
+
+TEST(GraphTiersSuite, mpi_adaptive_batch_correctness_test) {
+    InputNodeOptions options;
+    options.max_batch_size = MAX_ADAPTIVE_BATCH_SIZE;
+    run_mpi_correctness(options);
+}
+
+TEST(GraphTiersSuite, local_transport_correctness_test) {
+    int world_rank_buf;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank_buf);
+    // Every node runs as a thread of this rank, the other MPI ranks have nothing to do
+    if (world_rank_buf != 0)
+        return;
+
+    BinaryGraphStream stream(stream_file, 100000);
+    uint32_t num_nodes = stream.nodes();
+    uint32_t num_tiers = log2(num_nodes)/(log2(3)-1);
+    // Parameters
+    int update_batch_size = DEFAULT_BATCH_SIZE;
+    int num_ranks = std::min(num_tiers+1, (uint32_t)4);
+    height_factor = 1./log2(log2(num_nodes));
+    sketch_len = Sketch::calc_vector_length(num_nodes);
+    sketch_err = DEFAULT_SKETCH_ERR;
+
+    // Seeds
+    std::random_device dev;
+    std::mt19937 rng(dev());
+    std::uniform_int_distribution<std::mt19937::result_type> dist(0,MAX_INT);
+    int seed = dist(rng);
+    std::cout << "SEED: " << seed << std::endl;
+    rng.seed(seed);
+    std::vector<int> tier_seeds(num_ranks);
+    for (int i = 0; i < num_ranks; i++)
+        tier_seeds[i] = dist(rng);
+
+    bool failed = false;
+    run_local(num_ranks, [&](Transport& world) {
+        if (world.rank() == 0) {
+            InputNode input_node(num_nodes, num_tiers, update_batch_size, seed, default_graph_config(), InputNodeOptions(), world);
+            MatGraphVerifier gv(num_nodes);
+            int edgecount = std::min(stream.edges(), (uint64_t)100000);
+            for (int i = 0; i < edgecount; i++) {
+                // Read an update from the stream and have the input node process it
+                GraphUpdate update = stream.get_edge();
+                input_node.update(update);
+                // Correctness testing by performing a cc query
+                gv.edge_update(update.edge.src, update.edge.dst);
+                unlikely_if(i%1000 == 0 || i == edgecount-1) {
+                    std::vector<std::set<node_id_t>> cc = input_node.cc_query();
+                    try {
+                        gv.reset_cc_state();
+                        gv.verify_soln(cc);
+                    } catch (IncorrectCCException& e) {
+                        std::cout << "Incorrect connected components found at update "  << i << std::endl;
+                        std::cout << "GOT: " << cc.size() << std::endl;
+                        failed = true;
+                        break;
+                    }
+                }
+            }
+            // Communicate to all other nodes that the stream has ended
+            input_node.end();
+        } else {
+            TierNode tier_node(num_nodes, num_tiers, update_batch_size, tier_seeds[world.rank()],
+                default_graph_config(), 1, world);
+            tier_node.main();
+        }
+    });
+    ASSERT_FALSE(failed);
+    std::cout << "Local transport with " << num_ranks << " ranks, CCs correct." << std::endl;
+}
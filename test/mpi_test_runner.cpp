@@ -8,7 +8,9 @@ int batch_size_arg;
 double height_factor_arg;
 
 int main(int argc, char** argv) {
-  MPI_Init(&argc, &argv);
+  // Tier nodes hosting several tiers run their tiers on worker threads, only the main thread uses MPI
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
   
   if (argc < 4) {
     std::cerr << "INCORRECT NUMBER OF ARGUMENTS." << std::endl;
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <fstream>
+#include <chrono>
+#include "rc_tree.h"
+#include "link_cut_tree.h"
+
+TEST(RCTreeSuite, random_links_and_cuts) {
+    int nodecount = 1000;
+    int seed = time(NULL);
+    std::cout << "Seeding rc tree test with " << seed << std::endl;
+    srand(seed);
+    RCTree forest(nodecount, seed);
+    LinkCutTree lct(nodecount);
+    // Apply the same random links and cuts to both backends and compare their answers
+    for (int i = 0; i < 20*nodecount; i++) {
+        node_id_t a = rand() % nodecount, b = rand() % nodecount;
+        if (a == b) continue;
+        PathMaxResult expected = lct.connected_path_max(a, b);
+        PathMaxResult result = forest.connected_path_max(a, b);
+        ASSERT_EQ(result.connected, expected.connected);
+        ASSERT_EQ(result.weight, expected.weight);
+        ASSERT_EQ(forest.has_edge(a, b), lct.has_edge(a, b));
+        ASSERT_EQ(forest.get_edge_weight(a, b), lct.get_edge_weight(a, b));
+        ASSERT_EQ(forest.find_root(a) == forest.find_root(b), expected.connected);
+        if (result.connected) {
+            node_id_t c = result.max_edge >> 32;
+            node_id_t d = result.max_edge & 0xFFFFFFFF;
+            ASSERT_EQ(forest.get_edge_weight(c, d), result.weight);
+            ASSERT_EQ(lct.get_edge_weight(c, d), result.weight);
+            // Cut the same maximum weight edge in both since ties may pick different edges
+            forest.cut(c, d);
+            lct.cut(c, d);
+        } else {
+            uint32_t weight = 1 + rand()%100;
+            forest.link(a, b, weight);
+            lct.link(a, b, weight);
+        }
+    }
+    // The batched version answers in the order of the queries
+    std::vector<std::pair<node_id_t, node_id_t>> queries;
+    for (int i = 0; i < 1000; i++)
+        queries.push_back({rand() % nodecount, rand() % nodecount});
+    std::vector<PathMaxResult> batched = forest.connected_path_max(queries);
+    ASSERT_EQ(batched.size(), queries.size());
+    for (uint32_t i = 0; i < queries.size(); i++) {
+        PathMaxResult expected = lct.connected_path_max(queries[i].first, queries[i].second);
+        ASSERT_EQ(batched[i].connected, expected.connected);
+        ASSERT_EQ(batched[i].weight, expected.weight);
+    }
+}
+
+TEST(RCTreeSuite, long_path_and_star) {
+    int nodecount = 20000;
+    int seed = time(NULL);
+    std::cout << "Seeding rc tree path test with " << seed << std::endl;
+    srand(seed);
+    RCTree forest(nodecount, seed);
+    LinkCutTree lct(nodecount);
+    // A path through a random order of half the nodes, the rest hang off node 0 so it has a long chain
+    int path_length = nodecount/2;
+    std::vector<node_id_t> order(path_length);
+    for (int i = 0; i < path_length; i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+    for (int i = 0; i+1 < path_length; i++) {
+        uint32_t weight = 1 + rand()%1000;
+        forest.link(order[i], order[i+1], weight);
+        lct.link(order[i], order[i+1], weight);
+    }
+    for (int i = path_length; i < nodecount; i++) {
+        uint32_t weight = 1 + rand()%1000;
+        forest.link(order[0], i, weight);
+        lct.link(order[0], i, weight);
+    }
+    for (int i = 0; i < 2000; i++) {
+        // Alternate between queries and cutting then relinking a random path edge with a new weight
+        node_id_t a = rand() % nodecount, b = rand() % nodecount;
+        PathMaxResult expected = lct.connected_path_max(a, b);
+        PathMaxResult result = forest.connected_path_max(a, b);
+        ASSERT_EQ(result.connected, expected.connected);
+        ASSERT_EQ(result.weight, expected.weight);
+        int j = rand() % (path_length-1);
+        uint32_t weight = 1 + rand()%1000;
+        forest.cut(order[j], order[j+1]);
+        lct.cut(order[j], order[j+1]);
+        ASSERT_FALSE(forest.connected_path_max(order[0], order[path_length-1]).connected);
+        forest.link(order[j], order[j+1], weight);
+        lct.link(order[j], order[j+1], weight);
+    }
+}
+
+// Time links, path queries and cut, query, link rounds of both backends on a long path and on a random tree
+template <class Tree>
+void time_dynamic_tree(std::string name, int nodecount, bool path, std::ofstream& out) {
+    Tree tree(nodecount);
+    std::mt19937 rng(nodecount);
+    std::vector<node_id_t> order(nodecount);
+    for (int i = 0; i < nodecount; i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<std::pair<node_id_t, node_id_t>> edges;
+    for (int i = 1; i < nodecount; i++)
+        edges.push_back({order[path ? i-1 : rng()%i], order[i]});
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto edge : edges)
+        tree.link(edge.first, edge.second, 1 + rng()%20);
+    auto link_end = std::chrono::high_resolution_clock::now();
+    uint64_t checksum = 0;
+    for (int i = 0; i < 100000; i++)
+        checksum += tree.connected_path_max(rng()%nodecount, rng()%nodecount).weight;
+    auto query_end = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 50000; i++) {
+        auto edge = edges[rng()%edges.size()];
+        tree.cut(edge.first, edge.second);
+        checksum += tree.connected_path_max(rng()%nodecount, rng()%nodecount).connected;
+        tree.link(edge.first, edge.second, 1 + rng()%20);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto ms = [](auto from, auto to) { return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count(); };
+    std::cout << name << (path ? " path" : " random tree") << " of " << nodecount << " nodes: links " << ms(start, link_end)
+        << " ms, 100000 queries " << ms(link_end, query_end) << " ms, 50000 cut query link rounds " << ms(query_end, end)
+        << " ms (checksum " << checksum << ")" << std::endl;
+    out << name << (path ? " path " : " random ") << nodecount << " " << ms(start, link_end) << " " << ms(link_end, query_end)
+        << " " << ms(query_end, end) << std::endl;
+}
+
+TEST(RCTreeSuite, path_max_speed_test) {
+    std::ofstream out("dynamic_tree_results.txt", std::ios_base::app);
+    for (bool path : {true, false}) {
+        time_dynamic_tree<LinkCutTree>("LCT", 100000, path, out);
+        time_dynamic_tree<RCTree>("RC", 100000, path, out);
+    }
+    out.close();
+}
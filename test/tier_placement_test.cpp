@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+#include "tier_placement.h"
+
+TEST(TierPlacementSuite, contiguous_ranges) {
+    for (uint32_t num_tiers : {1, 7, 13, 30}) {
+        for (uint32_t num_ranks = 1; num_ranks <= num_tiers; num_ranks++) {
+            TierPlacement placement(num_tiers, num_ranks);
+            // Every tier is on exactly one rank and the ranks cover the tiers in order
+            uint32_t next_tier = 0;
+            for (int rank = 1; rank <= (int)num_ranks; rank++) {
+                ASSERT_EQ(placement.first_tier(rank), next_tier) << num_tiers << " tiers on " << num_ranks << " ranks";
+                ASSERT_GT(placement.num_tiers_on(rank), 0);
+                for (uint32_t i = 0; i < placement.num_tiers_on(rank); i++)
+                    ASSERT_EQ(placement.rank_of(next_tier+i), rank) << "Tier " << next_tier+i;
+                next_tier += placement.num_tiers_on(rank);
+                // The upper ranks never host fewer tiers than the ranks below them
+                if (rank > 1) {
+                    ASSERT_GE(placement.num_tiers_on(rank), placement.num_tiers_on(rank-1));
+                }
+            }
+            ASSERT_EQ(next_tier, num_tiers);
+        }
+    }
+}
+
+TEST(TierPlacementSuite, one_tier_per_rank) {
+    // With a rank for every tier, tier i is on rank i+1 as the protocol always assumed
+    TierPlacement placement(13, 13);
+    for (uint32_t tier = 0; tier < 13; tier++) {
+        ASSERT_EQ(placement.rank_of(tier), (int)tier+1);
+        ASSERT_EQ(placement.num_tiers_on(tier+1), 1);
+    }
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include "tier_thread_pool.h"
+
+TEST(TierThreadPoolSuite, tier_affinity_test) {
+    uint32_t num_tiers = 20;
+    for (uint32_t num_threads : {1, 4, 32}) {
+        TierThreadPool pool(num_tiers, num_threads);
+        std::vector<std::thread::id> owner(num_tiers);
+        std::vector<uint32_t> count(num_tiers, 0);
+        pool.for_tiers(0, num_tiers, [&](uint32_t tier) {
+            owner[tier] = std::this_thread::get_id();
+            count[tier]++;
+        });
+        // Every later job on a tier runs exactly once on the same thread
+        for (int round = 0; round < 1000; round++) {
+            uint32_t first = round % num_tiers;
+            pool.for_tiers(first, num_tiers, [&](uint32_t tier) {
+                ASSERT_EQ(owner[tier], std::this_thread::get_id());
+                count[tier]++;
+            });
+        }
+        for (uint32_t tier = 0; tier < num_tiers; tier++)
+            ASSERT_EQ(count[tier], 1 + 50*(tier+1)) << "Tier " << tier << " with " << num_threads << " threads";
+    }
+}
+
+TEST(TierThreadPoolSuite, poll_while_waiting_test) {
+    uint32_t num_tiers = 8;
+    TierThreadPool pool(num_tiers, 4);
+    // The caller sees the progress a worker publishes before the job completes
+    std::atomic<uint32_t> progress{0};
+    std::atomic<bool> seen{false};
+    std::thread::id caller = std::this_thread::get_id();
+    pool.for_tiers(0, num_tiers, [&](uint32_t tier) {
+        if (tier != 0)
+            return;
+        progress.store(1);
+        while (!seen.load())
+            std::this_thread::yield();
+    }, [&]() {
+        ASSERT_EQ(std::this_thread::get_id(), caller);
+        if (progress.load() == 1)
+            seen.store(true);
+    });
+    ASSERT_TRUE(seen.load());
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "wire_format.h"
+
+static void expect_round_trip(const std::vector<GraphUpdate>& updates, bool expect_varint) {
+    uint32_t num_updates = updates.size();
+    std::vector<uint8_t> payload(max_payload_bytes(num_updates));
+    uint8_t flags = BATCH_CONCURRENT_REFRESH;
+    uint32_t payload_bytes = encode_updates(updates.data(), num_updates, payload.data(), flags);
+    ASSERT_LE(payload_bytes, max_payload_bytes(num_updates));
+    ASSERT_EQ((bool)(flags & BATCH_VARINT), expect_varint);
+    // Encoding only adds its own flag
+    ASSERT_TRUE(flags & BATCH_CONCURRENT_REFRESH);
+
+    std::vector<GraphUpdate> decoded(num_updates);
+    decode_updates(payload.data(), num_updates, flags, decoded.data());
+    for (uint32_t i = 0; i < num_updates; i++) {
+        ASSERT_EQ(decoded[i].edge.src, updates[i].edge.src) << "Update " << i;
+        ASSERT_EQ(decoded[i].edge.dst, updates[i].edge.dst) << "Update " << i;
+        ASSERT_EQ(decoded[i].type, updates[i].type) << "Update " << i;
+    }
+}
+
+TEST(WireFormatSuite, update_round_trip) {
+    std::mt19937 rng(0);
+    // Nearby vertex ids take the varint encoding
+    std::vector<GraphUpdate> updates;
+    for (node_id_t i = 0; i < 1000; i++) {
+        GraphUpdate update;
+        update.edge.src = i/4;
+        update.edge.dst = i/4 + rng()%32;
+        update.type = (rng()%2) ? DELETE : INSERT;
+        updates.push_back(update);
+    }
+    expect_round_trip(updates, true);
+
+    // Far apart ids fall back to the fixed encoding, including ids that use 31 bits
+    updates.clear();
+    for (int i = 0; i < 1000; i++) {
+        GraphUpdate update;
+        update.edge.src = rng() & ~(1u << 31);
+        update.edge.dst = rng() & ~(1u << 31);
+        update.type = (rng()%2) ? DELETE : INSERT;
+        updates.push_back(update);
+    }
+    updates[0].edge.src = (1u << 31) - 1;
+    expect_round_trip(updates, false);
+
+    // An empty batch has no payload
+    uint8_t flags = BATCH_END;
+    ASSERT_EQ(encode_updates(nullptr, 0, nullptr, flags), 0);
+}
+
+TEST(WireFormatSuite, packed_messages) {
+    // Messages go over the wire as raw bytes so their layouts must not carry padding
+    ASSERT_EQ(sizeof(BatchHeader), 10);
+    ASSERT_EQ(sizeof(EttUpdateMessage), 13);
+    ASSERT_EQ(sizeof(EttRefreshStepMessage), 26);
+    ASSERT_EQ(sizeof(LctResponseMessage), 13);
+    ASSERT_EQ(sizeof(RefreshEndpoint), 17);
+    ASSERT_EQ(sizeof(RefreshMessage), 34);
+    ASSERT_EQ(sizeof(QueryNodeMessage), 13);
+}